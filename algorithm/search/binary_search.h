@@ -11,10 +11,11 @@ namespace algorithm {
 namespace search {
 
 // enhanced binary search
-class BinarySearch
+template <class Policy>
+class BasicBinarySearch
 {
 public:
-    BinarySearch(double tol, ToleranceBy by):
+    BasicBinarySearch(double tol, ToleranceBy by):
         tolerance_(tol), by_(by), base_(-1), scale_(1) {};
 
     virtual void Init() 
@@ -53,22 +54,8 @@ public:
     }
 
 protected:
-    virtual bool Match(const double p, const double target)
-    {
-        switch (by_)
-        {
-        case ToleranceBy::PPM:
-            if (base_ < 0)
-                return util::mass::SpectrumMass::ComputePPM(p, target) < tolerance_;
-            else
-                return std::abs(p - target) / base_ * 1000000.0 < tolerance_; 
-        case ToleranceBy::Dalton:
-            return std::abs(p - target) < tolerance_ * scale_;
-        default:
-            break;
-        }
-        return false;
-    }
+    bool Match(const double p, const double target) const
+        { return Policy::Match(p, target, tolerance_, base_, scale_, by_); }
 
     double tolerance_; 
     ToleranceBy by_;
@@ -77,6 +64,8 @@ protected:
     double scale_;
 };
 
+typedef BasicBinarySearch<DynamicTolerance> BinarySearch;
+
 } // namespace algorithm
 } // namespace search 
 
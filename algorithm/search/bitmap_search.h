@@ -0,0 +1,151 @@
+#ifndef ALGORITHM_BITMAP_SEARCH_H
+#define ALGORITHM_BITMAP_SEARCH_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include "search.h"
+
+namespace algorithm {
+namespace search {
+
+// bitmap of occupied bins over sorted values at the tolerance resolution,
+// plus a compact bin -> value map ranked by popcount. Storage is kept
+// between Init calls, so rebuilding it for every spectrum does not allocate.
+// Bins are log scaled under a ppm policy, so that a window always spans few bins.
+template <class Policy>
+class BasicBitmapSearch
+{
+public:
+    BasicBitmapSearch(double tol, ToleranceBy by):
+        tolerance_(tol), by_(by) {};
+
+    // values must be ascending
+    void Init(const double* value, int n)
+    {
+        size_ = n;
+        bins_ = 0;
+        start_.clear();
+        if (n == 0) return;
+
+        min_ = std::max(value[0], 1e-6);
+        width_ = Policy::BinWidth(tolerance_, by_);
+        bins_ = Index(value[n-1]) + 1;
+        bits_.assign((bins_ + 63) / 64, 0);
+
+        int prev = -1;
+        for(int i = 0; i < n; i++)
+        {
+            int bin = Index(value[i]);
+            if (bin != prev)
+            {
+                bits_[bin >> 6] |= (uint64_t) 1 << (bin & 63);
+                start_.push_back(i);
+                prev = bin;
+            }
+        }
+        start_.push_back(n);
+
+        rank_.resize(bits_.size());
+        int count = 0;
+        for(int w = 0; w < (int) bits_.size(); w++)
+        {
+            rank_[w] = count;
+            count += __builtin_popcountll(bits_[w]);
+        }
+    }
+
+    double Tolerance() const { return tolerance_; }
+    ToleranceBy ToleranceType() const { return by_; }
+    void set_tolerance(double tol) { tolerance_ = tol; }
+    void set_tolerance_by(ToleranceBy by) { by_ = by; }
+
+    // values in the bins overlapping [lower, upper] are the index range [first, last),
+    // candidates still to be compared at full precision
+    bool Search(double lower, double upper, int& first, int& last) const
+    {
+        if (bins_ == 0 || upper < lower || upper < min_)
+            return false;
+        int a = lower <= min_ ? 0 : Index(lower);
+        int b = std::min(Index(upper), bins_ - 1);
+        if (a > b)
+            return false;
+
+        int low = NextBit(a, b);
+        if (low < 0)
+            return false;
+        int high = PrevBit(a, b);
+        first = start_[Rank(low)];
+        last = start_[Rank(high) + 1];
+        return true;
+    }
+
+    // full precision test of data p against q, ppm relative to the base,
+    // dalton scaled by the charge
+    bool Match(const double p, const double q, const double base, const double scale) const
+        { return Policy::Match(p, q, tolerance_, base, scale, by_); }
+
+protected:
+    int Index(double value) const
+    {
+        double index = Policy::Bin(value, min_, width_, by_);
+        if (index <= 0) return 0;
+        if (index >= kMaxBins) return kMaxBins;
+        return (int) index;
+    }
+
+    // number of occupied bins before the bin
+    int Rank(int bin) const
+    {
+        uint64_t mask = ((uint64_t) 1 << (bin & 63)) - 1;
+        return rank_[bin >> 6] + __builtin_popcountll(bits_[bin >> 6] & mask);
+    }
+
+    // first occupied bin in [a, b], or -1
+    int NextBit(int a, int b) const
+    {
+        for(int w = a >> 6; w <= (b >> 6); w++)
+        {
+            uint64_t word = bits_[w];
+            if (w == (a >> 6)) word &= ~(uint64_t) 0 << (a & 63);
+            if (word)
+            {
+                int bin = (w << 6) + __builtin_ctzll(word);
+                return bin <= b ? bin : -1;
+            }
+        }
+        return -1;
+    }
+
+    // last occupied bin in [a, b], a range known to hold one
+    int PrevBit(int a, int b) const
+    {
+        for(int w = b >> 6; w >= (a >> 6); w--)
+        {
+            uint64_t word = bits_[w];
+            if (w == (b >> 6) && (b & 63) != 63) word &= ((uint64_t) 1 << ((b & 63) + 1)) - 1;
+            if (word)
+                return (w << 6) + 63 - __builtin_clzll(word);
+        }
+        return a;
+    }
+
+    static constexpr int kMaxBins = 1 << 28;
+
+    double tolerance_;
+    ToleranceBy by_;
+    int size_ = 0;
+    int bins_ = 0;
+    double min_ = 0;
+    double width_ = 1;
+    std::vector<uint64_t> bits_;
+    std::vector<int> rank_;     // word -> occupied bins before it
+    std::vector<int> start_;    // occupied bin rank -> first value
+};
+
+typedef BasicBitmapSearch<DynamicTolerance> BitmapSearch;
+
+} // namespace algorithm
+} // namespace search
+
+#endif
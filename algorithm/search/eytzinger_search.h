@@ -0,0 +1,168 @@
+#ifndef ALGORITHM_EYTZINGER_SEARCH_H
+#define ALGORITHM_EYTZINGER_SEARCH_H
+
+#include <vector>
+#include "search.h"
+#include "binary_search.h"
+
+namespace algorithm {
+namespace search {
+
+// sorted values in bfs (eytzinger) order, node k has children 2k and 2k+1.
+// A lower bound descends without branches, and prefetches the two cache lines
+// holding the nodes four levels down, so that the misses of a large array
+// overlap instead of coming one per level.
+class EytzingerLayout
+{
+public:
+    EytzingerLayout() = default;
+
+    void Init(const std::vector<double>& sorted)
+    {
+        size_ = sorted.size();
+        tree_.resize(size_ + 1);
+        rank_.resize(size_ + 1);
+        int i = 0;
+        Build(sorted, i, 1);
+    }
+
+    int Size() const { return size_; }
+
+    // node of the first value >= target, or 0
+    int LowerBoundNode(const double target) const
+    {
+        int k = 1;
+        while (k <= size_)
+        {
+            __builtin_prefetch(tree_.data() + (long) k * 16);
+            __builtin_prefetch(tree_.data() + (long) k * 16 + 8);
+            k = 2 * k + (tree_[k] < target);
+        }
+        // undo the right turns taken after the last left turn
+        return k >> __builtin_ffs(~k);
+    }
+
+    // index in the sorted array of the first value >= target, or Size()
+    int LowerBound(const double target) const
+    {
+        int k = LowerBoundNode(target);
+        return k == 0 ? size_ : rank_[k];
+    }
+
+    double Value(int node) const { return tree_[node]; }
+    int Rank(int node) const { return rank_[node]; }
+
+protected:
+    void Build(const std::vector<double>& sorted, int& i, int k)
+    {
+        if (k > size_) return;
+        Build(sorted, i, 2 * k);
+        tree_[k] = sorted[i];
+        rank_[k] = i++;
+        Build(sorted, i, 2 * k + 1);
+    }
+
+    int size_ = 0;
+    std::vector<double> tree_; // 1-based, tree_[0] unused
+    std::vector<int> rank_;    // node -> sorted index
+};
+
+// BasicSearch over the eytzinger layout of the point values
+template <class T, class Policy = DynamicTolerance>
+class EytzingerSearch : public BasicSearch<T, Policy>
+{
+public:
+    EytzingerSearch(double tol, ToleranceBy by):
+        BasicSearch<T, Policy>(tol, by) { };
+
+    void Init() override
+    {
+        BasicSearch<T, Policy>::Init();
+        values_.resize(this->data_.size());
+        for(int i = 0; i < (int) this->data_.size(); i++)
+        {
+            values_[i] = this->data_[i]->Value();
+        }
+        layout_.Init(values_);
+    }
+
+    std::vector<T> Query(const double target) override
+    {
+        std::vector<T> result;
+        double upper;
+        for(int i = First(target, upper); i < (int) values_.size() && values_[i] <= upper; i++)
+        {
+            if (this->Match(this->data_[i].get(), target))
+                result.push_back(this->data_[i]->Content());
+        }
+        return result;
+    }
+
+    bool Search(const double target) override
+    {
+        double upper;
+        for(int i = First(target, upper); i < (int) values_.size() && values_[i] <= upper; i++)
+        {
+            if (this->Match(this->data_[i].get(), target))
+                return true;
+        }
+        return false;
+    }
+
+protected:
+    // first candidate of the tolerance window, widened for rounding
+    int First(const double target, double& upper) const
+    {
+        double lower;
+        Policy::Window(target, this->tolerance_, this->base_, this->scale_, this->by_, lower, upper);
+        return layout_.LowerBound(lower - std::abs(lower) * 1e-12);
+    }
+
+    std::vector<double> values_;
+    EytzingerLayout layout_;
+};
+
+// BinarySearch over the eytzinger layout of the data
+template <class Policy>
+class BasicEytzingerBinarySearch : public BasicBinarySearch<Policy>
+{
+public:
+    BasicEytzingerBinarySearch(double tol, ToleranceBy by):
+        BasicBinarySearch<Policy>(tol, by) { };
+
+    void Init() override
+    {
+        BasicBinarySearch<Policy>::Init();
+        layout_.Init(this->data_);
+    }
+
+    bool Search(const double target) override
+    {
+        double lower, upper;
+        Policy::Window(target, this->tolerance_, this->base_, this->scale_, this->by_, lower, upper);
+        // widened for rounding, the tree node itself answers most queries
+        int k = layout_.LowerBoundNode(lower - std::abs(lower) * 1e-12);
+        if (k == 0 || layout_.Value(k) > upper)
+            return false;
+        if (this->Match(layout_.Value(k), target))
+            return true;
+
+        const std::vector<double>& data = this->data_;
+        for(int i = layout_.Rank(k) + 1; i < (int) data.size() && data[i] <= upper; i++)
+        {
+            if (this->Match(data[i], target))
+                return true;
+        }
+        return false;
+    }
+
+protected:
+    EytzingerLayout layout_;
+};
+
+typedef BasicEytzingerBinarySearch<DynamicTolerance> EytzingerBinarySearch;
+
+} // namespace algorithm
+} // namespace search
+
+#endif
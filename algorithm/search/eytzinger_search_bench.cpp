@@ -0,0 +1,57 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "binary_search.h"
+#include "eytzinger_search.h"
+
+// lookup latency of BinarySearch over the sorted and the eytzinger layout,
+// for array sizes from 1k to 10M masses
+
+using namespace algorithm::search;
+
+template <class Searcher>
+double Latency(Searcher& searcher, const std::vector<double>& target, int& found)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for(const auto& it : target)
+    {
+        found += searcher.Search(it);
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / target.size();
+}
+
+int main(int argc, char *argv[])
+{
+    const int queries = 1000000;
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> mass(500.0, 6000.0);
+
+    std::vector<double> target(queries);
+    for(auto& it : target) it = mass(gen);
+
+    int found = 0;
+    std::cout << std::setw(10) << "size" << std::setw(14) << "sorted (ns)"
+        << std::setw(16) << "eytzinger (ns)" << std::endl;
+    for(int size = 1000; size <= 10000000; size *= 10)
+    {
+        std::vector<double> data(size);
+        for(auto& it : data) it = mass(gen);
+
+        BasicBinarySearch<DaltonTolerance> sorted(0.01, ToleranceBy::Dalton);
+        BasicEytzingerBinarySearch<DaltonTolerance> eytzinger(0.01, ToleranceBy::Dalton);
+        sorted.set_data(data);
+        sorted.Init();
+        eytzinger.set_data(data);
+        eytzinger.Init();
+
+        double sorted_time = Latency(sorted, target, found);
+        double eytzinger_time = Latency(eytzinger, target, found);
+        std::cout << std::setw(10) << size << std::setw(14) << sorted_time
+            << std::setw(16) << eytzinger_time << std::endl;
+    }
+    std::cout << "checksum: " << found << std::endl;
+    return 0;
+}
@@ -6,14 +6,14 @@
 #include <cstdlib>
 #include <algorithm> 
 #include "point.h"
+#include "tolerance.h"
 #include "../../util/mass/spectrum.h"
 
 namespace algorithm {
 namespace search {
 
-enum class ToleranceBy { PPM, Dalton}; 
-
-template <class T>
+// the tolerance policy defaults to the run time ToleranceBy
+template <class T, class Policy = DynamicTolerance>
 class BasicSearch
 {
 typedef std::vector<std::shared_ptr<Point<T>>> Points;
@@ -90,25 +90,8 @@ public:
     }
 
 protected:
-    virtual bool Match(const Point<T>* p, const double target)
-    {
-        double diff; 
-        switch (by_)
-        {
-        case ToleranceBy::PPM:
-            if (base_ < 0)
-                diff = util::mass::SpectrumMass::ComputePPM(p->Value(), target);
-            else
-                diff = std::abs(p->Value() - target) / base_ * 1000000.0;
-            return diff < tolerance_;
-        case ToleranceBy::Dalton:
-            diff = p->Value() - target;
-            return std::abs(diff) < tolerance_ * scale_;
-        default:
-            break;
-        }
-        return false;
-    }
+    bool Match(const Point<T>* p, const double target) const
+        { return Policy::Match(p->Value(), target, tolerance_, base_, scale_, by_); }
     static bool BasicComp(const std::shared_ptr<Point<T>>& p1, const std::shared_ptr<Point<T>>& p2)
         { return p1->Value() < p2->Value(); }
 
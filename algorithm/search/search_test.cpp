@@ -4,7 +4,9 @@
 #include <string>
 #include <iostream>
 #include "search.h"
-#include "bucket_search.h"
+#include "binary_search.h"
+#include "eytzinger_search.h"
+#include "bitmap_search.h"
 #include <unordered_map>
 
 
@@ -30,13 +32,123 @@ BOOST_AUTO_TEST_CASE( Algorithm_test )
     searcher.set_data(box);
     std::vector<double> res = searcher.Query(40);
     BOOST_CHECK(res.size() == 39);
+}
 
-    BucketSearch<double> bucket_searcher(20.0, ToleranceBy::Dalton);
-    bucket_searcher.set_data(box);
-    bucket_searcher.Init();
-    res = bucket_searcher.Query(40);
-    BOOST_CHECK(bucket_searcher.Search(50));
-    BOOST_CHECK(res.size() == 39);
+
+BOOST_AUTO_TEST_CASE( Tolerance_test ) 
+{
+    std::vector<std::shared_ptr<Point<double>>> box; 
+    for(int i=1; i<100; i++)
+    {
+        box.push_back(CreatePoint(i * 10.0));
+    }
+
+    // policies fixed at compile time agree with the run time switch
+    BasicSearch<double, DaltonTolerance> dalton(5.0, ToleranceBy::Dalton);
+    dalton.set_data(box);
+    dalton.Init();
+    BOOST_CHECK(dalton.Query(404.0).size() == 1);
+    dalton.set_scale(2);
+    BOOST_CHECK(dalton.Query(404.0).size() == 2);
+
+    BasicSearch<double, PPMTolerance> ppm(10, ToleranceBy::PPM);
+    ppm.set_data(box);
+    ppm.Init();
+    BOOST_CHECK(ppm.Search(500.004));
+    BOOST_CHECK(!ppm.Search(500.006));
+
+    BasicSearch<double, BasePPMTolerance> base_ppm(10, ToleranceBy::PPM);
+    base_ppm.set_data(box);
+    base_ppm.Init();
+    base_ppm.set_base(1000000.0);
+    BOOST_CHECK(base_ppm.Query(505.0).size() == 2);
+
+    BinarySearch binary(10, ToleranceBy::PPM);
+    BasicBinarySearch<PPMTolerance> binary_ppm(10, ToleranceBy::PPM);
+    std::vector<double> data {100.0, 200.0, 300.0};
+    binary.set_data(data);
+    binary.Init();
+    binary_ppm.set_data(data);
+    binary_ppm.Init();
+    BOOST_CHECK(binary.Search(200.001) && binary_ppm.Search(200.001));
+    BOOST_CHECK(!binary.Search(200.003) && !binary_ppm.Search(200.003));
+}
+
+
+BOOST_AUTO_TEST_CASE( Eytzinger_test ) 
+{
+    // same answers as the sorted layout, for every tree shape up to 40 nodes
+    for(int n = 0; n <= 40; n++)
+    {
+        std::vector<std::shared_ptr<Point<double>>> box; 
+        std::vector<double> data;
+        for(int i = 0; i < n; i++)
+        {
+            box.push_back(CreatePoint(i * 3.0 + (i % 4)));
+            data.push_back(i * 3.0 + (i % 4));
+        }
+
+        BasicSearch<double> sorted(1.5, ToleranceBy::Dalton);
+        EytzingerSearch<double> eytzinger(1.5, ToleranceBy::Dalton);
+        BinarySearch binary(1.5, ToleranceBy::Dalton);
+        EytzingerBinarySearch binary_eytzinger(1.5, ToleranceBy::Dalton);
+        sorted.set_data(box);
+        sorted.Init();
+        eytzinger.set_data(box);
+        eytzinger.Init();
+        binary.set_data(data);
+        binary.Init();
+        binary_eytzinger.set_data(data);
+        binary_eytzinger.Init();
+
+        for(double target = -5.0; target < n * 3.0 + 5.0; target += 0.7)
+        {
+            std::vector<double> expect = sorted.Query(target);
+            std::vector<double> result = eytzinger.Query(target);
+            std::sort(expect.begin(), expect.end());
+            BOOST_CHECK(expect == result);
+            BOOST_CHECK(eytzinger.Search(target) == sorted.Search(target));
+            BOOST_CHECK(binary_eytzinger.Search(target) == binary.Search(target));
+        }
+    }
+
+    EytzingerSearch<double, PPMTolerance> ppm(10, ToleranceBy::PPM);
+    ppm.set_data({CreatePoint(100.0), CreatePoint(200.0), CreatePoint(300.0)});
+    ppm.Init();
+    BOOST_CHECK(ppm.Search(200.001));
+    BOOST_CHECK(!ppm.Search(200.003));
+}
+
+
+BOOST_AUTO_TEST_CASE( Bitmap_test ) 
+{
+    BitmapSearch searcher(0.5, ToleranceBy::Dalton);
+    std::vector<double> data {2.0, 2.1, 10.0, 12.0, 100.0};
+    searcher.Init(data.data(), data.size());
+
+    int first, last;
+    BOOST_CHECK(searcher.Search(1.8, 2.2, first, last));
+    BOOST_CHECK(first == 0 && last == 2);
+    BOOST_CHECK(searcher.Search(9.5, 12.4, first, last));
+    BOOST_CHECK(first == 2 && last == 4);
+    BOOST_CHECK(searcher.Search(99.9, 200.0, first, last));
+    BOOST_CHECK(first == 4 && last == 5);
+    BOOST_CHECK(!searcher.Search(50.0, 51.0, first, last));
+    BOOST_CHECK(!searcher.Search(0.0, 1.0, first, last));
+
+    // storage reused by the next spectrum
+    std::vector<double> next {500.0};
+    searcher.Init(next.data(), next.size());
+    BOOST_CHECK(!searcher.Search(1.8, 2.2, first, last));
+    BOOST_CHECK(searcher.Search(499.8, 500.2, first, last));
+    BOOST_CHECK(first == 0 && last == 1);
+
+    BitmapSearch ppm_searcher(10, ToleranceBy::PPM);
+    ppm_searcher.Init(data.data(), data.size());
+    BOOST_CHECK(ppm_searcher.Search(99.9995, 100.0005, first, last));
+    BOOST_CHECK(first == 4 && last == 5);
+    BOOST_CHECK(ppm_searcher.Match(100.0, 100.0005, 100.0, 1));
+    BOOST_CHECK(!ppm_searcher.Match(100.0, 100.002, 100.0, 1));
 }
 
 
@@ -0,0 +1,130 @@
+#ifndef ALGORITHM_SEARCH_TOLERANCE_H
+#define ALGORITHM_SEARCH_TOLERANCE_H
+
+#include <cmath>
+#include <limits>
+
+namespace algorithm {
+namespace search {
+
+enum class ToleranceBy { PPM, Dalton};
+
+// tolerance policies of the search templates, fixed at compile time so that
+// the comparison inlines. p is the stored value and q the target; Window gives
+// the range of p that may match q. Bin is the position of a value among bins
+// of BinWidth from min on, a bin about as wide as the tolerance.
+
+// ppm relative to the stored value
+struct PPMTolerance
+{
+    static bool Match(const double p, const double q, const double tol,
+        const double base, const double scale, const ToleranceBy by)
+        { return std::abs(p - q) / p * 1000000.0 < tol; }
+
+    static void Window(const double q, const double tol, const double base,
+        const double scale, const ToleranceBy by, double& lower, double& upper)
+    {
+        double ppm = tol / 1000000.0;
+        lower = q / (1 + ppm);
+        upper = ppm < 1 ? q / (1 - ppm) : std::numeric_limits<double>::max();
+    }
+
+    static double BinWidth(const double tol, const ToleranceBy by)
+        { return std::log1p(tol / 1000000.0); }
+
+    static double Bin(const double value, const double min, const double width, const ToleranceBy by)
+        { return std::log(value / min) / width; }
+};
+
+// ppm relative to a fixed base, such as the precursor mass
+struct BasePPMTolerance
+{
+    static bool Match(const double p, const double q, const double tol,
+        const double base, const double scale, const ToleranceBy by)
+        { return std::abs(p - q) / base * 1000000.0 < tol; }
+
+    static void Window(const double q, const double tol, const double base,
+        const double scale, const ToleranceBy by, double& lower, double& upper)
+    {
+        lower = q - tol / 1000000.0 * base;
+        upper = q + tol / 1000000.0 * base;
+    }
+
+    static double BinWidth(const double tol, const ToleranceBy by)
+        { return std::log1p(tol / 1000000.0); }
+
+    static double Bin(const double value, const double min, const double width, const ToleranceBy by)
+        { return std::log(value / min) / width; }
+};
+
+// dalton, scaled by the charge when comparing masses
+struct DaltonTolerance
+{
+    static bool Match(const double p, const double q, const double tol,
+        const double base, const double scale, const ToleranceBy by)
+        { return std::abs(p - q) < tol * scale; }
+
+    static void Window(const double q, const double tol, const double base,
+        const double scale, const ToleranceBy by, double& lower, double& upper)
+    {
+        lower = q - tol * scale;
+        upper = q + tol * scale;
+    }
+
+    static double BinWidth(const double tol, const ToleranceBy by)
+        { return tol; }
+
+    static double Bin(const double value, const double min, const double width, const ToleranceBy by)
+        { return (value - min) / width; }
+};
+
+// chosen at run time by ToleranceBy, ppm relative to the base when set (>= 0)
+struct DynamicTolerance
+{
+    static bool Match(const double p, const double q, const double tol,
+        const double base, const double scale, const ToleranceBy by)
+    {
+        switch (by)
+        {
+        case ToleranceBy::PPM:
+            if (base < 0)
+                return PPMTolerance::Match(p, q, tol, base, scale, by);
+            return BasePPMTolerance::Match(p, q, tol, base, scale, by);
+        case ToleranceBy::Dalton:
+            return DaltonTolerance::Match(p, q, tol, base, scale, by);
+        default:
+            break;
+        }
+        return false;
+    }
+
+    static void Window(const double q, const double tol, const double base,
+        const double scale, const ToleranceBy by, double& lower, double& upper)
+    {
+        if (by == ToleranceBy::Dalton)
+            DaltonTolerance::Window(q, tol, base, scale, by, lower, upper);
+        else if (base < 0)
+            PPMTolerance::Window(q, tol, base, scale, by, lower, upper);
+        else
+            BasePPMTolerance::Window(q, tol, base, scale, by, lower, upper);
+    }
+
+    static double BinWidth(const double tol, const ToleranceBy by)
+    {
+        if (by == ToleranceBy::Dalton)
+            return DaltonTolerance::BinWidth(tol, by);
+        return PPMTolerance::BinWidth(tol, by);
+    }
+
+    static double Bin(const double value, const double min, const double width, const ToleranceBy by)
+    {
+        if (by == ToleranceBy::Dalton)
+            return DaltonTolerance::Bin(value, min, width, by);
+        return PPMTolerance::Bin(value, min, width, by);
+    }
+};
+
+} // namespace algorithm
+} // namespace search
+
+#endif
@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <map>
+
+#include <argp.h>
+
+#include "../search/search_parameter.h"
+#include "../search/search_helper.h"
+
+#include "../../util/mass/ion.h"
+#include "../../util/mass/spectrum.h"
+#include "../../engine/protein/protein_ptm.h"
+
+
+const char *argp_program_version =
+  "glycoseq fragment v1.0";
+const char *argp_program_bug_address =
+  "<rz20@iu.edu>";
+
+static char doc[] =
+  "Fragment -- export the theoretical fragment ions of the digested glycopeptides";
+
+static struct argp_option options[] = {
+    {"fpath", 'f',    "protein.fasta",  0,  "fasta, Protein Sequence Input Path" },
+    {"output",    'o',    "fragment.csv",   0,  "csv, Fragment Ions Output Path" },
+    {"digestion",   'd',  "TG",  0,  "The Digestion, Trypsin (T), Pepsin (P), Chymotrypsin (C), GluC (G)" },
+    {"miss_cleavage",   's',  "2",  0,  "The Missing Cleavage Upto" },
+    {"ions",   'e',  "bcyz",  0,  "The Ion Series, any of a, b, c, x, y, z" },
+    {"charge",   'c',  "1",  0,  "Export m/z Up to Charge" },
+    { 0 }
+};
+
+static std::string default_fasta_path =
+        "/home/yu/Documents/GlycoSeq-Cpp/data/haptoglobin.fasta";
+static std::string default_out_path = "fragment.csv";
+static std::string default_digestion = "TG";
+static std::string default_ions = "bcyz";
+
+struct arguments
+{
+    char * fasta_path = const_cast<char*> (default_fasta_path.c_str());
+    char * out_path = const_cast<char*> (default_out_path.c_str());
+    //digestion
+    int miss_cleavage = 2;
+    char * digestion = const_cast<char*> (default_digestion.c_str());
+    // fragments
+    char * ions = const_cast<char*> (default_ions.c_str());
+    int charge = 1;
+};
+
+
+static error_t
+parse_opt (int key, char *arg, struct argp_state *state)
+{
+    error_t err = 0;
+    struct arguments *arguments =  static_cast<struct arguments*>(state->input);
+
+    switch (key)
+    {
+    case 'c':
+        arguments->charge = atoi(arg);
+        break;
+
+    case 'd':
+        arguments->digestion = arg;
+        break;
+
+    case 'e':
+        arguments->ions = arg;
+        break;
+
+    case 'f':
+        arguments->fasta_path = arg;
+        break;
+
+    case 'o':
+        arguments->out_path = arg;
+        break;
+
+    case 's':
+        arguments->miss_cleavage = atoi(arg);
+        break;
+
+    default:
+        return ARGP_ERR_UNKNOWN;
+    }
+    return err;
+}
+
+static struct argp argp = { options, parse_opt, 0, doc };
+
+
+SearchParameter GetParameter(const struct arguments& arguments)
+{
+    SearchParameter parameter;
+    parameter.miss_cleavage = arguments.miss_cleavage;
+    parameter.proteases.clear();
+    std::string protease(arguments.digestion);
+    for(const char& c : protease)
+    {
+        switch (c)
+        {
+        case 'T': case 't':
+            parameter.proteases.push_back(engine::protein::Proteases::Trypsin);
+            break;
+
+        case 'G': case 'g':
+            parameter.proteases.push_back(engine::protein::Proteases::GluC);
+            break;
+
+        case 'P': case 'p':
+            parameter.proteases.push_back(engine::protein::Proteases::Pepsin);
+            break;
+        case 'C': case 'c':
+            parameter.proteases.push_back(engine::protein::Proteases::Chymotrypsin);
+            break;
+
+        default:
+            break;
+        }
+    }
+    return parameter;
+}
+
+std::map<char, util::mass::IonType> GetIons(const std::string& ions_str)
+{
+    std::map<char, util::mass::IonType> ions;
+    for(const char& c : ions_str)
+    {
+        switch (std::tolower(c))
+        {
+        case 'a':
+            ions['a'] = util::mass::IonType::a;
+            break;
+        case 'b':
+            ions['b'] = util::mass::IonType::b;
+            break;
+        case 'c':
+            ions['c'] = util::mass::IonType::c;
+            break;
+        case 'x':
+            ions['x'] = util::mass::IonType::x;
+            break;
+        case 'y':
+            ions['y'] = util::mass::IonType::y;
+            break;
+        case 'z':
+            ions['z'] = util::mass::IonType::z;
+            break;
+        default:
+            break;
+        }
+    }
+    return ions;
+}
+
+int main(int argc, char *argv[])
+{
+    // parse arguments
+    struct arguments arguments;
+    argp_parse (&argp, argc, argv, 0, 0, &arguments);
+    std::string fasta_path(arguments.fasta_path);
+    std::string out_path(arguments.out_path);
+    SearchParameter parameter = GetParameter(arguments);
+    std::map<char, util::mass::IonType> ions = GetIons(arguments.ions);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // read fasta and build peptides
+    std::unordered_set<std::string> seqs = PeptidesDigestion(fasta_path, parameter);
+    std::vector<std::string> peptides(seqs.begin(), seqs.end());
+    std::sort(peptides.begin(), peptides.end());
+
+    // output ions, one ladder buffer reused by every peptide
+    std::ofstream outfile;
+    outfile.open (out_path);
+    outfile << std::fixed << std::setprecision(5);
+    outfile << "peptide,sites,ion,position,charge,mz\n";
+
+    util::mass::IonLadder ladder;
+    std::vector<double> buffer;
+    for(const auto& seq : peptides)
+    {
+        std::string sites;
+        for(const auto& pos : engine::protein::ProteinPTM::FindNGlycanSite(seq))
+        {
+            sites += (sites.empty() ? "" : " ") + std::to_string(pos);
+        }
+
+        ladder.Init(seq);
+        for(const auto& it : ions)
+        {
+            buffer.clear();
+            ladder.Compute(it.second, buffer);
+            for(int i = 0; i < (int) buffer.size(); i++)
+            {
+                // ion index counted from its own terminal
+                int position = util::mass::IonMass::NTerminal(it.second) ?
+                    i + 1 : ladder.Length() - i - 1;
+                for(int charge = 1; charge <= arguments.charge; charge++)
+                {
+                    outfile << seq << "," << sites << "," << it.first << ",";
+                    outfile << position << "," << charge << ",";
+                    outfile << util::mass::SpectrumMass::ComputeMZ(buffer[i], charge) << "\n";
+                }
+            }
+        }
+    }
+    outfile.close();
+
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::seconds>(stop - start);
+    std::cout << "Total peptides: " << peptides.size() << std::endl;
+    std::cout << "Total Time: " << duration.count() << std::endl;
+
+}
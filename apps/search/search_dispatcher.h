@@ -2,22 +2,37 @@
 #define APP_SEARCH_WORK_DISTRIBUTOR_H
 
 #include <deque>
+#include <unordered_set>
+#include <unordered_map>
 #include <thread>  
 #include <mutex> 
+#include <memory>
+#include <numeric>
+#include <algorithm>
 
 #include "search_parameter.h"
 #include "../../engine/spectrum/normalize.h"
+#include "../../engine/spectrum/deisotope.h"
+#include "../../engine/spectrum/oxonium_filter.h"
+#include "../../engine/spectrum/spectrum_cache.h"
 #include "../../engine/search/spectrum_search.h"
+#include "../../engine/search/fragment_table.h"
+#include "../../engine/search/fragment_index.h"
+#include "../../engine/search/fragment_store.h"
+#include "../../engine/search/precursor_calibration.h"
 
 class SearchQueue
 {
 public:
+    SearchQueue() = default;
     SearchQueue(const std::vector<model::spectrum::Spectrum>& spectra)
         { GenerateQueue(spectra); }
 
     SearchQueue(const SearchQueue& other)
     {
         queue_ = other.queue_;
+        candidates_ = other.candidates_;
+        decoys_ = other.decoys_;
     }
 
     virtual void GenerateQueue(
@@ -29,6 +44,23 @@ public:
         }
     }
 
+    // spectra queued with their precursor candidates
+    virtual void Push(const model::spectrum::Spectrum& spectrum, 
+        const engine::search::MatchResultStore& candidate)
+    {
+        queue_.push_back(spectrum);
+        candidates_.push_back(candidate);
+    }
+
+    // with the candidates of the decoy peptides as well
+    virtual void Push(const model::spectrum::Spectrum& spectrum, 
+        const engine::search::MatchResultStore& candidate,
+        const engine::search::MatchResultStore& decoy)
+    {
+        Push(spectrum, candidate);
+        decoys_.push_back(decoy);
+    }
+
     virtual model::spectrum::Spectrum TryGetSpectrum()
     {
         model::spectrum::Spectrum spec;
@@ -45,11 +77,51 @@ public:
         mutex_.unlock();
         return spec;
     }
-    
 
+    virtual model::spectrum::Spectrum TryGetSpectrum(engine::search::MatchResultStore& candidate)
+    {
+        model::spectrum::Spectrum spec;
+        mutex_.lock();
+            if (! queue_.empty())
+            {
+                spec = queue_.front();
+                queue_.pop_front();
+                candidate = candidates_.front();
+                candidates_.pop_front();
+            }
+            else
+            {
+                spec.set_scan(-1);
+            }
+        mutex_.unlock();
+        return spec;
+    }
+
+    virtual model::spectrum::Spectrum TryGetSpectrum(engine::search::MatchResultStore& candidate,
+        engine::search::MatchResultStore& decoy)
+    {
+        model::spectrum::Spectrum spec;
+        mutex_.lock();
+            if (! queue_.empty())
+            {
+                spec = queue_.front();
+                queue_.pop_front();
+                candidate = candidates_.front();
+                candidates_.pop_front();
+                decoy = decoys_.front();
+                decoys_.pop_front();
+            }
+            else
+            {
+                spec.set_scan(-1);
+            }
+        mutex_.unlock();
+        return spec;
+    }
 
 protected:
     std::deque<model::spectrum::Spectrum> queue_;
+    std::deque<engine::search::MatchResultStore> candidates_, decoys_;
     std::mutex mutex_; 
 };
 
@@ -60,9 +132,16 @@ class SearchDispatcher
 public:
     SearchDispatcher(const std::vector<model::spectrum::Spectrum>& spectra, 
         engine::glycan::NGlycanBuilder* builder, const std::vector<std::string>& peptides, 
-            SearchParameter parameter): queue_(SearchQueue(spectra)), builder_(builder), 
+            SearchParameter parameter): spectra_(spectra), builder_(builder), 
                 peptides_(peptides), parameter_(parameter){}
 
+    // target and decoy peptides searched together by JointDispatch
+    SearchDispatcher(const std::vector<model::spectrum::Spectrum>& spectra, 
+        engine::glycan::NGlycanBuilder* builder, const std::vector<std::string>& peptides, 
+            const std::vector<std::string>& decoy_peptides, SearchParameter parameter): 
+                SearchDispatcher(spectra, builder, peptides, parameter)
+                    { decoy_peptides_ = decoy_peptides; }
+
     engine::glycan::NGlycanBuilder* Builder() { return builder_; }
     std::vector<std::string> Peptides() { return peptides_; }
     SearchParameter Parameter() { return parameter_; }
@@ -70,13 +149,38 @@ public:
         { builder_ = builder; }
     void set_peptides(std::vector<std::string> peptides) 
         { peptides_ = peptides; }
+    std::vector<std::string> DecoyPeptides() { return decoy_peptides_; }
+    void set_decoy_peptides(std::vector<std::string> peptides) 
+        { decoy_peptides_ = peptides; }
     void set_parameter(SearchParameter parameter) 
         { parameter_ = parameter; }
+    // preprocessed spectra, kept across passes and shareable with other dispatchers
+    std::shared_ptr<engine::spectrum::SpectrumCache> Cache() { return cache_; }
+    void set_cache(std::shared_ptr<engine::spectrum::SpectrumCache> cache)
+        { cache_ = cache; }
+    // fragment table and indexes of the peptides, shareable with other dispatchers
+    std::shared_ptr<engine::search::FragmentStore> Fragments() { return fragments_; }
+    void set_fragments(std::shared_ptr<engine::search::FragmentStore> fragments)
+        { fragments_ = fragments; }
+    // target candidates checked against the score bound, and those pruned
+    long Bounded() const { return bounded_; }
+    long Pruned() const { return pruned_; }
+    // peptides skipped by the Y ion gate, targets and decoys
+    long Gated() const { return gated_; }
+    // precursor error found by the recalibration pass, and the ms1 tolerance searched
+    const engine::search::PrecursorCalibration& Calibration() const { return calibration_; }
+    double PrecursorTolerance() const { return parameter_.ms1_tol; }
+    // spectra kept for the search, and those dropped by the oxonium triage
+    int Spectra() const { return spectra_.size(); }
+    int Triaged() const { return triaged_; }
 
 
     std::vector<engine::search::SearchResult> Dispatch()
     {
         std::vector<engine::search::SearchResult> results;
+        PrepareFragments(peptides_);
+        Recalibrate();
+        MatchPrecursors();
         std::vector< std::thread> thread_pool;
         for (int i = 0; i < parameter_.n_thread; i ++)
         {
@@ -93,6 +197,8 @@ public:
     std::vector<engine::search::SearchResult> DecoyDispatch()
     {
         std::vector<engine::search::SearchResult> results;
+        PrepareFragments(peptides_);
+        MatchPrecursors();
         std::vector< std::thread> thread_pool;
         for (int i = 0; i < parameter_.n_thread; i ++)
         {
@@ -106,37 +212,324 @@ public:
         return results;
     }
 
+    // targets and decoys in one pass: one fragment table and one precursor sweep
+    // over both peptide sets, and each spectrum normalized once and searched
+    // against its target and decoy candidates by the same worker
+    void JointDispatch(std::vector<engine::search::SearchResult>& targets,
+        std::vector<engine::search::SearchResult>& decoys)
+    {
+        std::vector<std::string> joint(peptides_);
+        std::unordered_set<std::string> seen(peptides_.begin(), peptides_.end());
+        for(const auto& it : decoy_peptides_)
+        {
+            if (seen.insert(it).second)
+                joint.push_back(it);
+        }
+        PrepareFragments(joint);
+        Recalibrate();
+        MatchPrecursors(true);
+        std::vector< std::thread> thread_pool;
+        for (int i = 0; i < parameter_.n_thread; i ++)
+        {
+            std::thread worker(&SearchDispatcher::JointWorker, this, std::ref(targets), std::ref(decoys));
+            thread_pool.push_back(std::move(worker));
+        }
+        for (auto& worker : thread_pool)
+        {
+            worker.join();
+        }
+    }
+
 protected:
+    // the fragment table of the peptides, unless a fitting store holds it, and
+    // a backbone index for each ion series the spectra are activated for
+    void PrepareFragments(const std::vector<std::string>& peptides)
+    {
+        if (fragments_ == nullptr || !fragments_->Fits(parameter_.ms2_tol, parameter_.ms2_by) ||
+            (!fragments_->Empty() && !fragments_->Holds(peptides)))
+        {
+            fragments_ = std::make_shared<engine::search::FragmentStore>
+                (parameter_.ms2_tol, parameter_.ms2_by);
+        }
+        if (fragments_->Empty())
+            fragments_->Init(peptides, parameter_.n_thread);
+        for(auto& spec : spectra_)
+        {
+            fragments_->Build(engine::search::SeriesOf(spec.Type()));
+        }
+    }
+
+    template <class Policy>
+    void SetFragments(engine::search::BasicSpectrumSearcher<Policy>& spectrum_runner)
+    {
+        spectrum_runner.set_table(&fragments_->Table());
+        for(const auto& series : {engine::search::IonSeries::BY, 
+            engine::search::IonSeries::CZ, engine::search::IonSeries::All})
+        {
+            const engine::search::FragmentIndex* index = fragments_->Index(series);
+            if (index != nullptr)
+                spectrum_runner.set_index(index);
+        }
+    }
+
+    // a quick target search of a subsample of the spectra; the best match of
+    // the top scoring half estimates the systematic precursor error, which is
+    // taken out of every precursor before the main search, and a ppm ms1
+    // tolerance narrows to the spread left
+    void Recalibrate()
+    {
+        if (!parameter_.recalibrate || calibrated_) return;
+        calibrated_ = true;
+
+        int sample = std::max(1, parameter_.calibration_sample);
+        int step = std::max(1, ((int) spectra_.size() + sample - 1) / sample);
+        MatchPrecursors(false, step);
+        std::vector<engine::search::SearchResult> results;
+        std::vector< std::thread> thread_pool;
+        for (int i = 0; i < parameter_.n_thread; i ++)
+        {
+            std::thread worker(&SearchDispatcher::SearchingWorker, this, std::ref(results), false);
+            thread_pool.push_back(std::move(worker));
+        }
+        for (auto& worker : thread_pool)
+        {
+            worker.join();
+        }
+        bounded_ = 0;
+        pruned_ = 0;
+        gated_ = 0;
+
+        // best match of each scan
+        std::unordered_map<int, int> best;
+        for(int i = 0; i < (int) results.size(); i++)
+        {
+            auto it = best.find(results[i].Scan());
+            if (it == best.end() || results[it->second].RawScore() < results[i].RawScore())
+                best[results[i].Scan()] = i;
+        }
+        std::vector<int> matches;
+        for(const auto& it : best)
+        {
+            matches.push_back(it.second);
+        }
+        std::sort(matches.begin(), matches.end(), [&results](int i, int j)
+            { return results[i].RawScore() > results[j].RawScore() ||
+                (results[i].RawScore() == results[j].RawScore() && results[i].Scan() < results[j].Scan()); });
+        matches.resize((matches.size() + 1) / 2);
+
+        std::unordered_map<int, int> scans;
+        for(int i = 0; i < (int) spectra_.size(); i++)
+        {
+            scans[spectra_[i].Scan()] = i;
+        }
+        for(const auto& i : matches)
+        {
+            model::spectrum::Spectrum& spec = spectra_[scans[results[i].Scan()]];
+            double precursor_mass = 
+                util::mass::SpectrumMass::Compute(spec.PrecursorMZ(), spec.PrecursorCharge());
+            int isotope;
+            double error = engine::search::PrecursorCalibration::MatchError(results[i].Sequence(), 
+                results[i].Glycan(), precursor_mass, parameter_.isotopic_count, isotope);
+            if (isotope == 0)
+                calibration_.Add(spec.PrecursorMZ(), error);
+        }
+        if (!calibration_.Fit()) return;
+
+        for(auto& spec : spectra_)
+        {
+            spec.set_parent_mz(calibration_.Correct(spec.PrecursorMZ(), spec.PrecursorCharge()));
+        }
+        if (parameter_.ms1_by == algorithm::search::ToleranceBy::PPM)
+        {
+            double min_mass = 0;
+            for(auto& spec : spectra_)
+            {
+                double mass = util::mass::SpectrumMass::Compute(spec.PrecursorMZ(), spec.PrecursorCharge());
+                if (min_mass == 0 || (mass > 0 && mass < min_mass))
+                    min_mass = mass;
+            }
+            parameter_.ms1_tol = calibration_.Tolerance(parameter_.ms1_tol, parameter_.isotopic_count, min_mass);
+        }
+    }
+
+    // drop the spectra without oxonium ions before any candidate is built,
+    // once for all the precursor sweeps
+    void Triage()
+    {
+        if (filtered_) return;
+        filtered_ = true;
+        engine::spectrum::OxoniumFilter triage(parameter_.ms2_tol, parameter_.ms2_by);
+        triaged_ = triage.Filter(spectra_);
+    }
+
+    // preprocess the kept spectra once, unless a fitting cache holds them
+    void PrepareCache()
+    {
+        if (cache_ == nullptr || 
+            !cache_->Fits(parameter_.ms2_tol, parameter_.ms2_by, parameter_.deisotope))
+        {
+            cache_ = std::make_shared<engine::spectrum::SpectrumCache>
+                (parameter_.ms2_tol, parameter_.ms2_by, parameter_.deisotope);
+        }
+        if (cache_->Empty())
+            cache_->Init(spectra_, parameter_.n_thread);
+    }
+
+    // the cached spectrum of the scan, or one preprocessed into local
+    const engine::spectrum::PreprocessedSpectrum* Preprocessed(model::spectrum::Spectrum& spec,
+        engine::spectrum::Deisotoper& deisotoper, engine::spectrum::PreprocessedSpectrum& local)
+    {
+        const engine::spectrum::PreprocessedSpectrum* preprocessed = cache_->Find(spec.Scan());
+        if (preprocessed != nullptr)
+            return preprocessed;
+        local.Init(spec, parameter_.deisotope ? &deisotoper : nullptr);
+        return &local;
+    }
+
+    // precursor candidates of all spectra (or every step-th of them) in one
+    // sweep, then queue the matched spectra in precursor mass order
+    void MatchPrecursors(bool joint = false, int step = 1)
+    {
+        Triage();
+        PrepareCache();
+
+        // the tolerance policies are picked here and in the workers, once for
+        // the whole search, so that the mass comparisons inline
+        if (parameter_.ms1_by == algorithm::search::ToleranceBy::PPM)
+            QueuePrecursors<algorithm::search::BasePPMTolerance>(joint, step);
+        else
+            QueuePrecursors<algorithm::search::DaltonTolerance>(joint, step);
+    }
+
+    template <class Policy>
+    void QueuePrecursors(bool joint, int step)
+    {
+        engine::search::BasicPrecursorMatcher<Policy> precursor_runner
+            (parameter_.ms1_tol, parameter_.ms1_by, builder_->Isomer());
+        std::vector<std::string> glycans_str = builder_->Isomer().Collection();
+        if (joint)
+            precursor_runner.Init(peptides_, decoy_peptides_, glycans_str);
+        else
+            precursor_runner.Init(peptides_, glycans_str);
+
+        std::vector<int> selected;
+        std::vector<double> targets;
+        std::vector<int> charges;
+        for(int i = 0; i < (int) spectra_.size(); i += step)
+        {
+            model::spectrum::Spectrum& spec = spectra_[i];
+            selected.push_back(i);
+            targets.push_back(
+                util::mass::SpectrumMass::Compute(spec.PrecursorMZ(), spec.PrecursorCharge()));
+            charges.push_back(spec.PrecursorCharge());
+        }
+        std::vector<engine::search::MatchResultStore> decoys;
+        std::vector<engine::search::MatchResultStore> candidates = 
+            precursor_runner.BatchMatch(targets, charges, parameter_.isotopic_count, decoys);
+
+        std::vector<int> order(selected.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+            [&targets](int i, int j) { return targets[i] < targets[j]; });
+        for(const auto& i : order)
+        {
+            if (joint)
+            {
+                if (candidates[i].Empty() && decoys[i].Empty()) continue;
+                queue_.Push(spectra_[selected[i]], candidates[i], decoys[i]);
+                continue;
+            }
+            if (candidates[i].Empty()) continue;
+            queue_.Push(spectra_[selected[i]], candidates[i]);
+        }
+    }
+
+    void JointWorker(std::vector<engine::search::SearchResult>& targets,
+        std::vector<engine::search::SearchResult>& decoys)
+    {
+        if (parameter_.ms2_by == algorithm::search::ToleranceBy::PPM)
+            JointSearchSpectra<algorithm::search::PPMTolerance>(targets, decoys);
+        else
+            JointSearchSpectra<algorithm::search::DaltonTolerance>(targets, decoys);
+    }
+
+    template <class Policy>
+    void JointSearchSpectra(std::vector<engine::search::SearchResult>& targets,
+        std::vector<engine::search::SearchResult>& decoys)
+    {
+        engine::search::BasicSpectrumSearcher<Policy> spectrum_runner
+            (parameter_.ms2_tol, parameter_.ms2_by, parameter_.isotopic_count, builder_, false);
+        spectrum_runner.Init();
+        SetFragments(spectrum_runner);
+        spectrum_runner.set_top_k(parameter_.top_k);
+        spectrum_runner.set_y_gate(parameter_.y_gate);
+        spectrum_runner.set_deisotoped(parameter_.deisotope);
+        engine::spectrum::Deisotoper deisotoper(parameter_.ms2_tol, parameter_.ms2_by);
+        engine::spectrum::PreprocessedSpectrum local;
+
+        std::vector<engine::search::SearchResult> temp_target, temp_decoy, res_target, res_decoy;
+        engine::search::MatchResultStore r, d;
+        while (true)
+        {
+            // precursor matched
+            model::spectrum::Spectrum spec = queue_.TryGetSpectrum(r, d);
+            if (spec.Scan() < 0) break;
+
+            // preprocessed once per scan and shared by both
+            spectrum_runner.set_spectrum(Preprocessed(spec, deisotoper, local), spec.PrecursorMZ());
+
+            // msms
+            spectrum_runner.set_candidate(r);
+            spectrum_runner.JointSearch(d, res_target, res_decoy);
+            temp_target.insert(temp_target.end(), res_target.begin(), res_target.end());
+            temp_decoy.insert(temp_decoy.end(), res_decoy.begin(), res_decoy.end());
+        }
+
+        mutex_.lock();
+            targets.insert(targets.end(), temp_target.begin(), temp_target.end());
+            decoys.insert(decoys.end(), temp_decoy.begin(), temp_decoy.end());
+            bounded_ += spectrum_runner.Bounded();
+            pruned_ += spectrum_runner.Pruned();
+            gated_ += spectrum_runner.Gated();
+        mutex_.unlock();
+    }
+
     void SearchingWorker(
         std::vector<engine::search::SearchResult>& results, bool decoy_search)
     {
-        engine::search::PrecursorMatcher precursor_runner
-            (parameter_.ms1_tol, parameter_.ms1_by, builder_->Isomer());
-        engine::search::SpectrumSearcher spectrum_runner
+        if (parameter_.ms2_by == algorithm::search::ToleranceBy::PPM)
+            SearchSpectra<algorithm::search::PPMTolerance>(results, decoy_search);
+        else
+            SearchSpectra<algorithm::search::DaltonTolerance>(results, decoy_search);
+    }
+
+    template <class Policy>
+    void SearchSpectra(
+        std::vector<engine::search::SearchResult>& results, bool decoy_search)
+    {
+        engine::search::BasicSpectrumSearcher<Policy> spectrum_runner
             (parameter_.ms2_tol, parameter_.ms2_by, parameter_.isotopic_count, builder_, decoy_search);
-        std::vector<std::string> glycans_str = builder_->Isomer().Collection();
-        precursor_runner.Init(peptides_, glycans_str);
         spectrum_runner.Init();
+        SetFragments(spectrum_runner);
+        spectrum_runner.set_top_k(parameter_.top_k);
+        spectrum_runner.set_y_gate(parameter_.y_gate);
+        spectrum_runner.set_deisotoped(parameter_.deisotope);
+        engine::spectrum::Deisotoper deisotoper(parameter_.ms2_tol, parameter_.ms2_by);
+        engine::spectrum::PreprocessedSpectrum local;
 
         std::vector<engine::search::SearchResult> temp_result;
         
+        engine::search::MatchResultStore r;
         while (true)
         {
-            model::spectrum::Spectrum spec = queue_.TryGetSpectrum();
+            // precursor matched
+            model::spectrum::Spectrum spec = queue_.TryGetSpectrum(r);
             if (spec.Scan() < 0) break;
-            
-            // precusor
-            double target = 
-                util::mass::SpectrumMass::Compute(spec.PrecursorMZ(), spec.PrecursorCharge());
-            engine::search::MatchResultStore r = 
-                precursor_runner.Match(target, spec.PrecursorCharge(), parameter_.isotopic_count);
-            if (r.Empty()) continue;
 
-            // process spectrum by normalization
-            engine::spectrum::Normalizer::Transform(spec);
+            // preprocessed once per scan
+            spectrum_runner.set_spectrum(Preprocessed(spec, deisotoper, local), spec.PrecursorMZ());
 
             // msms
-            spectrum_runner.set_spectrum(spec);
             spectrum_runner.set_candidate(r);
             std::vector<engine::search::SearchResult> res = spectrum_runner.Search();
             if (res.empty()) continue;
@@ -146,14 +539,28 @@ protected:
         
         mutex_.lock();
             results.insert(results.end(), temp_result.begin(), temp_result.end());
+            bounded_ += spectrum_runner.Bounded();
+            pruned_ += spectrum_runner.Pruned();
+            gated_ += spectrum_runner.Gated();
         mutex_.unlock();
     }
 
     std::mutex mutex_; 
+    std::vector<model::spectrum::Spectrum> spectra_;
     SearchQueue queue_;
     engine::glycan::NGlycanBuilder* builder_;
     std::vector<std::string> peptides_;
+    std::vector<std::string> decoy_peptides_;
     SearchParameter parameter_;
+    std::shared_ptr<engine::search::FragmentStore> fragments_;
+    std::shared_ptr<engine::spectrum::SpectrumCache> cache_;
+    engine::search::PrecursorCalibration calibration_;
+    bool calibrated_ = false;
+    bool filtered_ = false;
+    long bounded_ = 0;
+    long pruned_ = 0;
+    long gated_ = 0;
+    int triaged_ = 0;
 
 };
 
@@ -27,6 +27,16 @@ struct SearchParameter
         algorithm::search::ToleranceBy::Dalton;
     // isotopic effects on precursor
     int isotopic_count = 0;
+    // candidates per spectrum fully scored after the prefilter, 0 for all
+    int top_k = 0;
+    // skip peptides without the Y0 or Y1 ion in the spectrum
+    bool y_gate = false;
+    // collapse isotope envelopes and match fragments singly charged
+    bool deisotope = false;
+    // correct the precursors by a first pass over a subsample of spectra,
+    // and narrow the ppm ms1 tolerance to the error left
+    bool recalibrate = false;
+    int calibration_sample = 1000;
     // fdr
     double fdr_rate = 0.01;
     // protease
@@ -51,6 +51,11 @@ static struct argp_option options[] = {
     {"ms1_by",   'k',  "0",  0, "MS Tolereance By Int: PPM (0) or Dalton (1)" },
     {"ms2_by",   'l',  "1",  0, "MS2 Tolereance By Int: PPM (0) or Dalton (1)" },
     {"fdr_rate",   'r',  "0.01",  0, "FDR rate" },
+    {"top_k",   'K',  "0",  0, "Candidates per Spectrum Fully Scored after Prefilter, 0 for All" },
+    {"y_gate",   'Y',  "0",  0, "Skip Peptides without Y0 or Y1 Ion By Int: No (0) or Yes (1)" },
+    {"deisotope",   'D',  "0",  0, "Deisotope and Charge Deconvolve MS2 By Int: No (0) or Yes (1)" },
+    {"recalibrate",   'E',  "0",  0, "Recalibrate Precursors and Narrow MS Tolerance By Int: No (0) or Yes (1)" },
+    {"cache",   'R',  "0",  0, "Reuse Preprocessed Spectra Saved Next to the Input By Int: No (0) or Yes (1)" },
     {"core_weight",   'a',  "1.0",  0, "Score Weight, Glycan's PentaCore Term" },
     {"branch_weight",   'A',  "1.0",  0, "Score Weight, Glycan's Branch Term" },
     {"terminal_weight",   'b',  "1.0",  0, "Score Weight, Glycan's Terminal Term" },
@@ -94,6 +99,12 @@ struct arguments
     int ms2_by = 1;
     // fdr
     double fdr_rate = 0.01;
+    // prefilter
+    int top_k = 0;
+    int y_gate = 0;
+    int deisotope = 0;
+    int recalibrate = 0;
+    int cache = 0;
     // weights
     double core_w = 1.0;
     double branch_w = 1.0;
@@ -161,6 +172,26 @@ parse_opt (int key, char *arg, struct argp_state *state)
         arguments->miss_cleavage = atoi(arg);
         break;
 
+    case 'K':
+        arguments->top_k = atoi(arg);
+        break;
+
+    case 'Y':
+        arguments->y_gate = atoi(arg);
+        break;
+
+    case 'D':
+        arguments->deisotope = atoi(arg);
+        break;
+
+    case 'E':
+        arguments->recalibrate = atoi(arg);
+        break;
+
+    case 'R':
+        arguments->cache = atoi(arg);
+        break;
+
     case 'u':
         arguments->neuAc_upper_bound = atoi(arg);
         break;
@@ -232,6 +263,10 @@ SearchParameter GetParameter(const struct arguments& arguments)
         algorithm::search::ToleranceBy::PPM :
         algorithm::search::ToleranceBy::Dalton;
     parameter.fdr_rate = arguments.fdr_rate;
+    parameter.top_k = arguments.top_k;
+    parameter.y_gate = arguments.y_gate != 0;
+    parameter.deisotope = arguments.deisotope != 0;
+    parameter.recalibrate = arguments.recalibrate != 0;
     std::string protease(arguments.digestion);
     for(const char& c : protease)
     {
@@ -314,13 +349,28 @@ int main(int argc, char *argv[])
     std::cout << "Start to scan\n"; 
     auto start = std::chrono::high_resolution_clock::now();
 
-    // seraching targets 
-    SearchDispatcher target_searcher(spectrum_reader->GetSpectrum(), builder.get(), peptides, parameter);
-    std::vector<engine::search::SearchResult> targets = target_searcher.Dispatch();
-
-    // seraching decoys
-    SearchDispatcher decoy_searcher(spectrum_reader->GetSpectrum(), builder.get(), decoy_peptides, parameter);
-    std::vector<engine::search::SearchResult> decoys = decoy_searcher.DecoyDispatch();
+    // seraching targets and decoys in one pass
+    SearchDispatcher searcher(spectrum_reader->GetSpectrum(), builder.get(), 
+        peptides, decoy_peptides, parameter);
+    std::string cache_path = engine::spectrum::SpectrumCache::PathOf(spectra_path);
+    std::shared_ptr<engine::spectrum::SpectrumCache> cache = 
+        std::make_shared<engine::spectrum::SpectrumCache>(parameter.ms2_tol, parameter.ms2_by, parameter.deisotope);
+    bool cached = arguments.cache != 0 && cache->Load(cache_path, spectra_path);
+    searcher.set_cache(cache);
+    std::vector<engine::search::SearchResult> targets, decoys;
+    searcher.JointDispatch(targets, decoys);
+    if (arguments.cache != 0 && !cached)
+        searcher.Cache()->Save(cache_path, spectra_path);
+    if (searcher.Calibration().Fitted())
+        std::cout << "Precursor error:" << searcher.Calibration().Offset() << " ppm + " 
+            << searcher.Calibration().Slope() << " ppm per m/z, MS tolerance:" 
+                << searcher.PrecursorTolerance() << std::endl;
+    std::cout << "Oxonium triage dropped:" << searcher.Triaged() << " of " 
+        << searcher.Triaged() + searcher.Spectra() << " spectra" << std::endl;
+    std::cout << "Pruned candidates:" << searcher.Pruned() 
+        << " of " << searcher.Bounded() << std::endl;
+    if (parameter.y_gate)
+        std::cout << "Y gate skipped peptides:" << searcher.Gated() << std::endl;
 
     // set up scorer
     std::thread scorer_first(ScoringWorker, std::ref(targets));
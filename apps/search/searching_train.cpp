@@ -51,6 +51,7 @@ static struct argp_option options[] = {
     {"ms2_tol",   'n',  "0.01",  0,  "MS2 Tolereance" },
     {"ms1_by",   'k',  "0",  0, "MS Tolereance By Int: PPM (0) or Dalton (1)" },
     {"ms2_by",   'l',  "1",  0, "MS2 Tolereance By Int: PPM (0) or Dalton (1)" },
+    {"cache",   'R',  "0",  0, "Reuse Preprocessed Spectra Saved Next to the Input By Int: No (0) or Yes (1)" },
     { 0 }
 };
 
@@ -81,6 +82,7 @@ struct arguments
     double ms2_tol = 0.01;
     int ms1_by = 0;
     int ms2_by = 1;
+    int cache = 0;
 };
 
 
@@ -153,6 +155,10 @@ parse_opt (int key, char *arg, struct argp_state *state)
         arguments->fuc_upper_bound = atoi(arg);
         break;
 
+    case 'R':
+        arguments->cache = atoi(arg);
+        break;
+
     default:
         return ARGP_ERR_UNKNOWN;
     }
@@ -267,6 +273,10 @@ int main(int argc, char *argv[])
     std::vector<std::vector<double>> X_train, X_test;
     std::vector<int> y_train, y_test;
 
+    // the peptides are the same for every dataset, their fragments are built once
+    std::shared_ptr<engine::search::FragmentStore> fragments = 
+        std::make_shared<engine::search::FragmentStore>(parameter.ms2_tol, parameter.ms2_by);
+
     int count = 0;
     int size = dataset.size();
     for(const auto& data : dataset)
@@ -285,7 +295,15 @@ int main(int argc, char *argv[])
 
         // seraching targets 
         SearchDispatcher target_searcher(spectrum_reader->GetSpectrum(), builder.get(), peptides, parameter);
+        std::string cache_path = engine::spectrum::SpectrumCache::PathOf(spectra_path);
+        std::shared_ptr<engine::spectrum::SpectrumCache> cache = 
+            std::make_shared<engine::spectrum::SpectrumCache>(parameter.ms2_tol, parameter.ms2_by, parameter.deisotope);
+        bool cached = arguments.cache != 0 && cache->Load(cache_path, spectra_path);
+        target_searcher.set_cache(cache);
+        target_searcher.set_fragments(fragments);
         std::vector<engine::search::SearchResult> targets = target_searcher.Dispatch();
+        if (arguments.cache != 0 && !cached)
+            target_searcher.Cache()->Save(cache_path, spectra_path);
 
 
         std::cout << "Total target:" << targets.size() << std::endl;
@@ -20,21 +20,23 @@ class GlycanStore
 public:
     StringsMapping Map() const { return map_; }
     std::unordered_map<std::string, double> Mass() const { return mass_; }
-    std::unordered_set<std::string> Query(const std::string item) const
+    std::unordered_set<std::string> Query(const std::string& item) const
     {
-        if (map_.find(item) != map_.end())
+        auto it = map_.find(item);
+        if (it != map_.end())
         {
-           return Map()[item];
+           return it->second;
         }
         std::unordered_set<std::string> result;
         return result;
     }
-    double QueryMass(const std::string item) const
+    double QueryMass(const std::string& item) const
     {
         double mass = 0;
-        if (map_.find(item) != map_.end())
+        auto it = mass_.find(item);
+        if (map_.find(item) != map_.end() && it != mass_.end())
         {
-           return Mass()[item];
+           return it->second;
         }
         return mass;
     }
@@ -85,11 +87,12 @@ public:
     DoublesMapping Map() const
         { return map_; }
 
-    std::unordered_set<double> Query(const std::string item) const
+    std::unordered_set<double> Query(const std::string& item) const
     {
-        if (map_.find(item) != map_.end())
+        auto it = map_.find(item);
+        if (it != map_.end())
         {
-           return Map()[item];
+           return it->second;
         }
         std::unordered_set<double> result;
         return result;
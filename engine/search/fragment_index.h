@@ -0,0 +1,142 @@
+#ifndef ENGINE_SEARCH_FRAGMENT_INDEX_H
+#define ENGINE_SEARCH_FRAGMENT_INDEX_H
+
+#include <vector>
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+#include "fragment_table.h"
+#include "../../algorithm/search/search.h"
+#include "../../model/spectrum/spectrum.h"
+#include "../../engine/spectrum/neutral_mass.h"
+
+namespace engine{
+namespace search{
+
+// inverted index of the peptide backbone ions of one ion series, binned at
+// the ms2 tolerance, each bin lists the (peptide, site) slots having an ion inside it
+class FragmentIndex
+{
+public:
+    // per-thread working space of Score
+    struct Workspace
+    {
+        std::vector<int> lookup; // slot -> candidate, or -1
+        std::vector<int> last;   // candidate -> last peak counted
+    };
+
+    FragmentIndex(double tol, algorithm::search::ToleranceBy by):
+        tolerance_(tol), by_(by){}
+
+    void Init(const FragmentTable& table, FragmentType type = FragmentType::NonePTM,
+        IonSeries series = IonSeries::All)
+    {
+        slots_ = table.Slots();
+        series_ = series;
+        mass_.clear();
+        slot_.clear();
+        bin_offset_.clear();
+
+        // postings ordered by mass
+        std::vector<std::pair<double, int>> postings;
+        for(int slot = 0; slot < slots_; slot++)
+        {
+            for(const double* it = table.Begin(slot, type, series); 
+                it != table.End(slot, type, series); it++)
+            {
+                postings.push_back(std::make_pair(*it, slot));
+            }
+        }
+        std::sort(postings.begin(), postings.end());
+        if (postings.empty()) return;
+
+        min_ = std::max(postings.front().first, 1.0);
+        width_ = algorithm::search::DynamicTolerance::BinWidth(tolerance_, by_);
+        int bins = Index(postings.back().first) + 1;
+        bin_offset_.assign(bins + 1, 0);
+        for(const auto& it : postings)
+        {
+            mass_.push_back(it.first);
+            slot_.push_back(it.second);
+            bin_offset_[Index(it.first) + 1]++;
+        }
+        std::partial_sum(bin_offset_.begin(), bin_offset_.end(), bin_offset_.begin());
+    }
+
+    double Tolerance() const { return tolerance_; }
+    algorithm::search::ToleranceBy ToleranceType() const { return by_; }
+    int Slots() const { return slots_; }
+    IonSeries Series() const { return series_; }
+    int Size() const { return mass_.size(); }
+
+    // scores[k] = sum of squared intensity of the peaks matching any ion of slots[k],
+    // every peak counted once however many charges or ions it matches; ppm
+    // relative to the ion. A fixed policy must be that of the tolerance type.
+    template <class Policy = algorithm::search::DynamicTolerance>
+    void Score(const engine::spectrum::NeutralMass& neutral,
+        const std::vector<model::spectrum::Peak>& peaks, const std::vector<int>& slots,
+            Workspace& space, std::vector<double>& scores) const
+    {
+        scores.assign(slots.size(), 0);
+        if (mass_.empty()) return;
+
+        space.lookup.resize(slots_, -1);
+        space.last.assign(slots.size(), -1);
+        for(int k = 0; k < (int) slots.size(); k++)
+        {
+            space.lookup[slots[k]] = k;
+        }
+
+        for(int i = 0; i < neutral.Size(); i++)
+        {
+            double intensity = peaks[neutral.Peak(i)].Intensity();
+            for(int charge = 1; charge <= neutral.MaxCharge(); charge++)
+            {
+                double target = neutral.Mass(charge)[i];
+                double low, high;
+                Policy::Window(target, tolerance_, -1, charge, by_, low, high);
+                int lower = std::max(Index<Policy>(low), 0);
+                int upper = std::min(Index<Policy>(high), (int) bin_offset_.size() - 2);
+                if (lower > upper) continue;
+                for(int j = bin_offset_[lower]; j < bin_offset_[upper + 1]; j++)
+                {
+                    int k = space.lookup[slot_[j]];
+                    if (k < 0 || space.last[k] == i) continue;
+                    if (Policy::Match(mass_[j], target, tolerance_, -1, charge, by_))
+                    {
+                        scores[k] += intensity * intensity;
+                        space.last[k] = i;
+                    }
+                }
+            }
+        }
+
+        for(const auto& slot : slots)
+        {
+            space.lookup[slot] = -1;
+        }
+    }
+
+protected:
+    template <class Policy = algorithm::search::DynamicTolerance>
+    int Index(double mass) const
+    {
+        if (mass <= min_) return 0;
+        return (int) Policy::Bin(mass, min_, width_, by_);
+    }
+
+    double tolerance_;
+    algorithm::search::ToleranceBy by_;
+    int slots_ = 0;
+    IonSeries series_ = IonSeries::All;
+    double min_ = 1.0;
+    double width_ = 1.0;
+    std::vector<double> mass_;
+    std::vector<int> slot_;
+    std::vector<int> bin_offset_; // bin -> first posting
+};
+
+} // namespace engine
+} // namespace search
+
+#endif
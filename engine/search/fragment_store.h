@@ -0,0 +1,63 @@
+#ifndef ENGINE_SEARCH_FRAGMENT_STORE_H
+#define ENGINE_SEARCH_FRAGMENT_STORE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "fragment_table.h"
+#include "fragment_index.h"
+#include "../../algorithm/search/tolerance.h"
+
+namespace engine{
+namespace search{
+
+// the fragment table of a peptide set and the backbone index of each ion
+// series searched, built once and shared by the searches of several
+// spectrum files against the same peptides under the same ms2 tolerance
+class FragmentStore
+{
+public:
+    FragmentStore(double tol, algorithm::search::ToleranceBy by):
+        tolerance_(tol), by_(by){}
+
+    double Tolerance() const { return tolerance_; }
+    algorithm::search::ToleranceBy ToleranceType() const { return by_; }
+    bool Fits(double tol, algorithm::search::ToleranceBy by) const
+        { return tolerance_ == tol && by_ == by; }
+    bool Holds(const std::vector<std::string>& peptides) const
+        { return table_.Peptides() == peptides; }
+    bool Empty() const { return table_.Size() == 0; }
+
+    void Init(const std::vector<std::string>& peptides, int n_thread)
+    {
+        table_.Init(peptides, n_thread);
+        for(auto& it : index_)
+        {
+            it.reset();
+        }
+    }
+
+    const FragmentTable& Table() const { return table_; }
+
+    // nullptr until the index of the series is built
+    const FragmentIndex* Index(IonSeries series) const
+        { return index_[(int) series].get(); }
+    void Build(IonSeries series)
+    {
+        std::unique_ptr<FragmentIndex>& index = index_[(int) series];
+        if (index != nullptr) return;
+        index = std::make_unique<FragmentIndex>(tolerance_, by_);
+        index->Init(table_, FragmentType::NonePTM, series);
+    }
+
+protected:
+    double tolerance_;
+    algorithm::search::ToleranceBy by_;
+    FragmentTable table_;
+    std::unique_ptr<FragmentIndex> index_[3];
+};
+
+} // namespace engine
+} // namespace search
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef ENGINE_SEARCH_FRAGMENT_TABLE_H
+#define ENGINE_SEARCH_FRAGMENT_TABLE_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <unordered_map>
+#include <algorithm>
+#include "../../util/mass/ion.h"
+#include "../../engine/protein/protein_ptm.h"
+#include "../../model/spectrum/spectrum.h"
+
+namespace engine{
+namespace search{
+
+// ions carrying the glycan (PTM) or the bare backbone (NonePTM)
+enum class FragmentType { PTM, NonePTM };
+
+// ion series an activation produces
+enum class IonSeries { BY, CZ, All };
+
+inline IonSeries SeriesOf(model::spectrum::SpectrumType type)
+{
+    switch (type)
+    {
+    case model::spectrum::SpectrumType::HCD:
+        return IonSeries::BY;
+    case model::spectrum::SpectrumType::ETD:
+        return IonSeries::CZ;
+    default:
+        break;
+    }
+    return IonSeries::All;
+}
+
+// read-only store of the b/c/y/z ions of every (peptide, site), built once
+// and shared by all searching threads. The ions of a slot are the sorted b/y
+// followed by the sorted c/z, so each series is a contiguous range.
+class FragmentTable
+{
+public:
+    FragmentTable() = default;
+
+    void Init(const std::vector<std::string>& peptides, int n_thread)
+    {
+        Clear();
+        peptides_ = peptides;
+        peptide_offset_.push_back(0);
+        offset_.push_back(0);
+        for(int id = 0; id < (int) peptides_.size(); id++)
+        {
+            index_[peptides_[id]] = id;
+            int ions = 2 * ((int) peptides_[id].length() - 1);
+            for(const auto& pos : engine::protein::ProteinPTM::FindNGlycanSite(peptides_[id]))
+            {
+                site_.push_back(pos);
+                offset_.push_back(offset_.back() + ions); // ptm
+                offset_.push_back(offset_.back() + ions); // none ptm
+            }
+            peptide_offset_.push_back(site_.size());
+        }
+        mass_.assign(offset_.back(), 0);
+
+        // each thread fills a disjoint range of peptides
+        n_thread = std::max(1, n_thread);
+        std::vector<std::thread> thread_pool;
+        for(int i = 0; i < n_thread; i++)
+        {
+            std::thread worker(&FragmentTable::Fill, this, i, n_thread);
+            thread_pool.push_back(std::move(worker));
+        }
+        for(auto& worker : thread_pool)
+        {
+            worker.join();
+        }
+    }
+
+    int Size() const { return peptides_.size(); }
+    const std::vector<std::string>& Peptides() const { return peptides_; }
+    const std::string& Sequence(int id) const { return peptides_[id]; }
+    int ID(const std::string& seq) const
+    {
+        auto it = index_.find(seq);
+        if (it == index_.end())
+            return -1;
+        return it->second;
+    }
+
+    // sites of a peptide are slots [SlotBegin(id), SlotEnd(id))
+    int SlotBegin(int id) const { return peptide_offset_[id]; }
+    int SlotEnd(int id) const { return peptide_offset_[id+1]; }
+    int Site(int slot) const { return site_[slot]; }
+    int Slots() const { return site_.size(); }
+    int Slot(int id, int pos) const
+    {
+        for(int slot = SlotBegin(id); slot < SlotEnd(id); slot++)
+        {
+            if (site_[slot] == pos)
+                return slot;
+        }
+        return -1;
+    }
+
+    const double* Begin(int slot, FragmentType type) const
+        { return mass_.data() + offset_[Range(slot, type)]; }
+    const double* End(int slot, FragmentType type) const
+        { return mass_.data() + offset_[Range(slot, type) + 1]; }
+    const double* Begin(int slot, FragmentType type, IonSeries series) const
+        { return series == IonSeries::CZ ? Middle(slot, type) : Begin(slot, type); }
+    const double* End(int slot, FragmentType type, IonSeries series) const
+        { return series == IonSeries::BY ? Middle(slot, type) : End(slot, type); }
+
+    void Clear()
+    {
+        peptides_.clear();
+        index_.clear();
+        peptide_offset_.clear();
+        site_.clear();
+        offset_.clear();
+        mass_.clear();
+    }
+
+    // for computing the peptide ions, written to out in O(L) as b, y, c, z;
+    // the b/y and the c/z take half of the ions each
+    static double* ComputePTMPeptideMass(const util::mass::IonLadder& ladder, const int pos, double* out)
+    {
+        int length = ladder.Length();
+        out = ladder.Compute(util::mass::IonType::b, pos + 1, length - 1, out); // seldom at n
+        out = ladder.Compute(util::mass::IonType::y, 1, pos, out);
+        out = ladder.Compute(util::mass::IonType::c, pos + 1, length - 1, out);
+        return ladder.Compute(util::mass::IonType::z, 1, pos, out);
+    }
+
+    static double* ComputeNonePTMPeptideMass(const util::mass::IonLadder& ladder, const int pos, double* out)
+    {
+        int length = ladder.Length();
+        out = ladder.Compute(util::mass::IonType::b, 1, pos, out);
+        out = ladder.Compute(util::mass::IonType::y, pos + 1, length - 1, out);
+        out = ladder.Compute(util::mass::IonType::c, 1, pos, out);
+        return ladder.Compute(util::mass::IonType::z, pos + 1, length - 1, out);
+    }
+
+    // sort the b/y and the c/z halves apart
+    static void Sort(double* begin, double* end)
+    {
+        double* middle = begin + (end - begin) / 2;
+        std::sort(begin, middle);
+        std::sort(middle, end);
+    }
+
+    static std::vector<double> ComputePTMPeptideMass(const std::string& seq, const int pos)
+    {
+        std::vector<double> mass_list(2 * (seq.length() - 1));
+        ComputePTMPeptideMass(util::mass::IonLadder(seq), pos, mass_list.data());
+        return mass_list;
+    }
+
+    static std::vector<double> ComputeNonePTMPeptideMass(const std::string& seq, const int pos)
+    {
+        std::vector<double> mass_list(2 * (seq.length() - 1));
+        ComputeNonePTMPeptideMass(util::mass::IonLadder(seq), pos, mass_list.data());
+        return mass_list;
+    }
+
+protected:
+    int Range(int slot, FragmentType type) const
+        { return slot * 2 + (type == FragmentType::PTM ? 0 : 1); }
+    const double* Middle(int slot, FragmentType type) const
+        { return Begin(slot, type) + (End(slot, type) - Begin(slot, type)) / 2; }
+
+    void Fill(int start, int step)
+    {
+        util::mass::IonLadder ladder;
+        for(int id = start; id < (int) peptides_.size(); id += step)
+        {
+            ladder.Init(peptides_[id]);
+            for(int slot = SlotBegin(id); slot < SlotEnd(id); slot++)
+            {
+                double* begin = mass_.data() + offset_[Range(slot, FragmentType::PTM)];
+                Sort(begin, ComputePTMPeptideMass(ladder, site_[slot], begin));
+                begin = mass_.data() + offset_[Range(slot, FragmentType::NonePTM)];
+                Sort(begin, ComputeNonePTMPeptideMass(ladder, site_[slot], begin));
+            }
+        }
+    }
+
+    std::vector<std::string> peptides_;
+    std::unordered_map<std::string, int> index_;
+    std::vector<int> peptide_offset_; // peptide id -> first slot
+    std::vector<int> site_;           // slot -> glycosylation site
+    std::vector<int> offset_;         // slot * 2 + type -> first ion
+    std::vector<double> mass_;
+};
+
+} // namespace engine
+} // namespace search
+
+#endif
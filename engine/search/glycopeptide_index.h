@@ -0,0 +1,263 @@
+#ifndef ENGINE_SEARCH_GLYCOPEPTIDE_INDEX_H
+#define ENGINE_SEARCH_GLYCOPEPTIDE_INDEX_H
+
+#include <vector>
+#include <deque>
+#include <queue>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <cmath>
+#include "../../algorithm/search/tolerance.h"
+#include "../../util/mass/spectrum.h"
+
+namespace engine{
+namespace search{
+
+// peptide + glycan composition masses in mass order. The sums are merged
+// lazily from one stream per composition (each walking the sorted peptide
+// masses); small databases keep the full merged list instead. A query
+// returns its candidates from the mass window directly. A ppm tolerance is
+// relative to the precursor mass, a dalton one scaled by its charge.
+template <class Policy>
+class BasicGlycopeptideIndex
+{
+public:
+    struct Entry
+    {
+        double mass;
+        int peptide;
+        int glycan;
+    };
+
+    BasicGlycopeptideIndex(double tol, algorithm::search::ToleranceBy by, long full_limit = 1 << 22):
+        tolerance_(tol), by_(by), full_limit_(full_limit){}
+
+    // candidates refer to the peptides and glycans by their position here
+    void Init(const std::vector<double>& peptide_mass, const std::vector<double>& glycan_mass)
+    {
+        peptide_mass_ = peptide_mass;
+        glycan_mass_ = glycan_mass;
+        order_.resize(peptide_mass_.size());
+        std::iota(order_.begin(), order_.end(), 0);
+        std::stable_sort(order_.begin(), order_.end(),
+            [this](int i, int j) { return peptide_mass_[i] < peptide_mass_[j]; });
+        sorted_.clear();
+        for(const auto& i : order_)
+        {
+            sorted_.push_back(peptide_mass_[i]);
+        }
+
+        entries_.clear();
+        full_ = (long) sorted_.size() * (long) glycan_mass_.size() <= full_limit_;
+        Rewind();
+        if (full_)
+        {
+            Entry e;
+            while (Next(e))
+            {
+                entries_.push_back(e);
+            }
+        }
+    }
+
+    bool Full() const { return full_; }
+    long Size() const { return (long) sorted_.size() * (long) glycan_mass_.size(); }
+    double Tolerance() const { return tolerance_; }
+    algorithm::search::ToleranceBy ToleranceType() const { return by_; }
+    void set_tolerance(double tol) { tolerance_ = tol; }
+    void set_tolerance_by(algorithm::search::ToleranceBy by) { by_ = by; }
+
+    // candidates within tolerance of the precursor or one of its isotopes,
+    // in mass order of each window. Queries in ascending mass keep the lazy
+    // merge going forward instead of restarting it.
+    std::vector<Entry> Query(const double target, const int charge, const int isotope)
+    {
+        std::vector<Window> windows = Windows(target, charge, isotope, 0);
+        if (!full_ && windows.front().lower < last_lower_)
+            Rewind(windows.front().lower);
+        std::vector<Entry> res;
+        for(const auto& w : windows)
+        {
+            Collect(w, res);
+        }
+        return res;
+    }
+
+    // candidates of many precursors, windows of all of them swept in mass order;
+    // result[j] equals Query(targets[j], charges[j], isotope)
+    std::vector<std::vector<Entry>> BatchQuery(const std::vector<double>& targets,
+        const std::vector<int>& charges, const int isotope)
+    {
+        std::vector<Window> windows;
+        for(int j = 0; j < (int) targets.size(); j++)
+        {
+            std::vector<Window> w = Windows(targets[j], charges[j], isotope, j);
+            windows.insert(windows.end(), w.begin(), w.end());
+        }
+        std::stable_sort(windows.begin(), windows.end(),
+            [](const Window& a, const Window& b) { return a.lower < b.lower; });
+
+        std::vector<std::vector<Entry>> res(targets.size());
+        if (!full_)
+            Rewind();
+        for(const auto& w : windows)
+        {
+            Collect(w, res[w.query]);
+        }
+        return res;
+    }
+
+protected:
+    struct Window
+    {
+        int query;
+        double target;
+        int charge;
+        double shift;
+        double lower;
+        double upper;
+    };
+
+    // the sum window of each isotope, lowest first
+    std::vector<Window> Windows(const double target, const int charge, const int isotope, const int query) const
+    {
+        std::vector<Window> windows;
+        for(int i = isotope; i >= 0; i--)
+        {
+            Window w;
+            w.query = query;
+            w.target = target;
+            w.charge = charge;
+            w.shift = i * util::mass::SpectrumMass::kIon;
+            double center = target - w.shift;
+            Policy::Window(center, tolerance_, target, charge, by_, w.lower, w.upper);
+            // the sums round differently from the peptide masses
+            double slack = std::abs(center) * 1e-12;
+            w.lower -= slack;
+            w.upper += slack;
+            windows.push_back(w);
+        }
+        return windows;
+    }
+
+    // same test as PrecursorMatcher, on the peptide mass
+    bool Hit(const Window& w, const Entry& e) const
+    {
+        double delta = w.target - glycan_mass_[e.glycan];
+        if (delta <= 0) return false;
+        double q = delta - w.shift;
+        return Policy::Match(peptide_mass_[e.peptide], q, tolerance_, w.target, w.charge, by_);
+    }
+
+    void Collect(const Window& w, std::vector<Entry>& res)
+    {
+        if (full_)
+        {
+            auto it = std::lower_bound(entries_.begin(), entries_.end(), w.lower,
+                [](const Entry& e, double v) { return e.mass < v; });
+            for(; it != entries_.end() && it->mass <= w.upper; ++it)
+            {
+                if (Hit(w, *it))
+                    res.push_back(*it);
+            }
+            return;
+        }
+
+        // windows come in ascending lower bound, sums below it are done with
+        while (!buffer_.empty() && buffer_.front().mass < w.lower)
+            buffer_.pop_front();
+        if (buffer_.empty())
+            Seek(w.lower);
+        Entry e;
+        while (!heap_.empty() && heap_.top().first <= w.upper && Next(e))
+        {
+            buffer_.push_back(e);
+        }
+        for(const auto& it : buffer_)
+        {
+            if (it.mass > w.upper) break;
+            if (Hit(w, it))
+                res.push_back(it);
+        }
+        last_lower_ = w.lower;
+    }
+
+    // restart every composition stream at its first sum from lower on
+    void Rewind(const double lower = -std::numeric_limits<double>::max())
+    {
+        buffer_.clear();
+        position_.assign(glycan_mass_.size(), 0);
+        last_lower_ = -std::numeric_limits<double>::max();
+        std::vector<std::pair<double, int>> heads;
+        for(int k = 0; k < (int) glycan_mass_.size(); k++)
+        {
+            double glycan = glycan_mass_[k];
+            auto it = std::lower_bound(sorted_.begin(), sorted_.end(), lower,
+                [glycan](double p, double v) { return p + glycan < v; });
+            position_[k] = it - sorted_.begin();
+            if (it != sorted_.end())
+                heads.push_back(std::make_pair(*it + glycan, k));
+        }
+        heap_ = Heap(std::greater<std::pair<double, int>>(), std::move(heads));
+    }
+
+    // skip the sums below lower, each stream jumps by a binary search
+    void Seek(const double lower)
+    {
+        while (!heap_.empty() && heap_.top().first < lower)
+        {
+            int k = heap_.top().second;
+            heap_.pop();
+            double glycan = glycan_mass_[k];
+            auto it = std::lower_bound(sorted_.begin() + position_[k], sorted_.end(), lower,
+                [glycan](double p, double v) { return p + glycan < v; });
+            position_[k] = it - sorted_.begin();
+            if (it != sorted_.end())
+                heap_.push(std::make_pair(*it + glycan, k));
+        }
+    }
+
+    // next sum in mass order, ties by composition
+    bool Next(Entry& e)
+    {
+        if (heap_.empty()) return false;
+        int k = heap_.top().second;
+        e.mass = heap_.top().first;
+        e.peptide = order_[position_[k]];
+        e.glycan = k;
+        heap_.pop();
+        if (++position_[k] < (int) sorted_.size())
+            heap_.push(std::make_pair(sorted_[position_[k]] + glycan_mass_[k], k));
+        return true;
+    }
+
+    typedef std::priority_queue<std::pair<double, int>,
+        std::vector<std::pair<double, int>>, std::greater<std::pair<double, int>>> Heap;
+
+    double tolerance_;
+    algorithm::search::ToleranceBy by_;
+    long full_limit_;
+    bool full_ = true;
+    std::vector<double> peptide_mass_;
+    std::vector<double> glycan_mass_;
+    // peptide positions by mass, and their masses
+    std::vector<int> order_;
+    std::vector<double> sorted_;
+    // full list
+    std::vector<Entry> entries_;
+    // lazy merge: next peptide of each composition, and the sums pulled
+    // from the merge that later windows may still need
+    Heap heap_;
+    std::vector<int> position_;
+    std::deque<Entry> buffer_;
+    double last_lower_ = -std::numeric_limits<double>::max();
+};
+
+typedef BasicGlycopeptideIndex<algorithm::search::DynamicTolerance> GlycopeptideIndex;
+
+} // namespace engine
+} // namespace search
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef ENGINE_SEARCH_PRECURSOR_CALIBRATION_H
+#define ENGINE_SEARCH_PRECURSOR_CALIBRATION_H
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "../../model/glycan/glycan.h"
+#include "../../util/mass/glycan.h"
+#include "../../util/mass/peptide.h"
+#include "../../util/mass/spectrum.h"
+
+namespace engine{
+namespace search{
+
+// systematic precursor error, in signed ppm of the observed over the
+// theoretical mass, estimated from confident matches: a line in m/z when
+// there are many of them, their median otherwise. The spread left after
+// the fit bounds a narrower ms1 tolerance.
+class PrecursorCalibration
+{
+public:
+    PrecursorCalibration(int min_points = 10, int linear_points = 50):
+        min_points_(min_points), linear_points_(linear_points){}
+
+    int Size() const { return mz_.size(); }
+    bool Fitted() const { return fitted_; }
+    double Offset() const { return offset_; }
+    double Slope() const { return slope_; }
+    double Spread() const { return spread_; }
+
+    void Add(double mz, double ppm)
+    {
+        mz_.push_back(mz);
+        ppm_.push_back(ppm);
+    }
+
+    // signed ppm error of the match; isotope is the 13C peak closest to
+    // the precursor, only monoisotopic matches should be fit
+    static double MatchError(const std::string& peptide, const std::string& composite,
+        double precursor_mass, int isotopic, int& isotope)
+    {
+        double mass = util::mass::PeptideMass::Compute(peptide)
+            + util::mass::GlycanMass::Compute(model::glycan::Glycan::Interpret(composite));
+        isotope = 0;
+        for(int i = 1; i <= isotopic; i++)
+        {
+            if (std::abs(precursor_mass - mass - util::mass::SpectrumMass::kIsotope * i) < 
+                std::abs(precursor_mass - mass - util::mass::SpectrumMass::kIsotope * isotope))
+                isotope = i;
+        }
+        return (precursor_mass - mass) / mass * 1000000.0;
+    }
+
+    // the points beyond 3 deviations of the median are left out of the fit
+    bool Fit()
+    {
+        fitted_ = false;
+        if ((int) ppm_.size() < min_points_) return false;
+
+        double median = Median(ppm_);
+        std::vector<double> deviation;
+        for(const auto& it : ppm_)
+        {
+            deviation.push_back(std::abs(it - median));
+        }
+        double limit = 3 * kNormal * Median(deviation);
+        std::vector<double> x, y;
+        for(int i = 0; i < (int) ppm_.size(); i++)
+        {
+            if (std::abs(ppm_[i] - median) > limit) continue;
+            x.push_back(mz_[i]);
+            y.push_back(ppm_[i]);
+        }
+
+        offset_ = Median(y);
+        slope_ = 0;
+        if ((int) x.size() >= linear_points_)
+        {
+            double mean_x = 0, mean_y = 0;
+            for(int i = 0; i < (int) x.size(); i++)
+            {
+                mean_x += x[i];
+                mean_y += y[i];
+            }
+            mean_x /= x.size();
+            mean_y /= y.size();
+            double cov = 0, var = 0;
+            for(int i = 0; i < (int) x.size(); i++)
+            {
+                cov += (x[i] - mean_x) * (y[i] - mean_y);
+                var += (x[i] - mean_x) * (x[i] - mean_x);
+            }
+            if (var > 0)
+            {
+                slope_ = cov / var;
+                offset_ = mean_y - slope_ * mean_x;
+            }
+        }
+
+        std::vector<double> residual;
+        for(int i = 0; i < (int) x.size(); i++)
+        {
+            residual.push_back(std::abs(y[i] - Error(x[i])));
+        }
+        spread_ = kNormal * Median(residual);
+        fitted_ = true;
+        return true;
+    }
+
+    double Error(double mz) const { return offset_ + slope_ * mz; }
+
+    // precursor mz with its systematic error taken out
+    double Correct(double mz, int charge) const
+    {
+        double mass = util::mass::SpectrumMass::Compute(mz, charge);
+        return util::mass::SpectrumMass::ComputeMZ(mass / (1 + Error(mz) / 1000000.0), charge);
+    }
+
+    // ppm tolerance covering the spread left, never wider than tol. The
+    // precursor windows step isotopes by kIon rather than the 13C spacing,
+    // so with isotopes searched the tolerance keeps that offset of the
+    // lightest precursor on top
+    double Tolerance(double tol, int isotopic = 0, double min_mass = 0) const
+    {
+        if (!fitted_) return tol;
+        double width = kWidth * spread_;
+        if (width < kMinTolerance)
+            width = kMinTolerance;
+        if (isotopic > 0 && min_mass > 0)
+            width += isotopic * (util::mass::SpectrumMass::kIon - util::mass::SpectrumMass::kIsotope) 
+                / min_mass * 1000000.0;
+        return std::min(tol, width);
+    }
+
+    static constexpr double kNormal = 1.4826; // deviation of a normal from its median deviation
+    static constexpr double kWidth = 4.0;
+    static constexpr double kMinTolerance = 2.0;
+
+protected:
+    static double Median(std::vector<double> values)
+    {
+        if (values.empty()) return 0;
+        int half = values.size() / 2;
+        std::nth_element(values.begin(), values.begin() + half, values.end());
+        double median = values[half];
+        if (values.size() % 2 == 0)
+            median = (median + *std::max_element(values.begin(), values.begin() + half)) / 2;
+        return median;
+    }
+
+    int min_points_;
+    int linear_points_;
+    std::vector<double> mz_;
+    std::vector<double> ppm_;
+    bool fitted_ = false;
+    double offset_ = 0;
+    double slope_ = 0;
+    double spread_ = 0;
+};
+
+} // namespace engine
+} // namespace search
+
+#endif
@@ -4,7 +4,7 @@
 #include <string>
 #include <vector>
 #include <unordered_set>
-#include "../../algorithm/search/search.h"
+#include "glycopeptide_index.h"
 #include "../../util/mass/peptide.h"
 #include "../../model/glycan/glycan.h"
 #include "../../util/mass/glycan.h"
@@ -59,13 +59,14 @@ protected:
         std::unordered_set<std::string>> map_;
 };
 
-class PrecursorMatcher
+// candidates of a precursor by its mass, under the tolerance policy of the index
+template <class Policy>
+class BasicPrecursorMatcher
 {
 public:
-    PrecursorMatcher(double tol, algorithm::search::ToleranceBy by, 
+    BasicPrecursorMatcher(double tol, algorithm::search::ToleranceBy by, 
         engine::glycan::GlycanStore isomer): tolerance_(tol), by_(by),
-            searcher_(algorithm::search::BasicSearch<std::string>(tol, by)),
-                isomer_(isomer){}
+            index_(tol, by), isomer_(isomer){}
 
     void Init(const std::vector<std::string>& peptides, const std::vector<std::string>& glycans)
     {
@@ -75,29 +76,46 @@ public:
         set_peptides(peptides);
     }
 
+    // targets and decoys in one index, the decoys follow the targets
+    void Init(const std::vector<std::string>& peptides, const std::vector<std::string>& decoys,
+        const std::vector<std::string>& glycans)
+    {
+        std::vector<std::string> joint(peptides);
+        joint.insert(joint.end(), decoys.begin(), decoys.end());
+        Init(joint, glycans);
+        decoy_begin_ = peptides.size();
+    }
+
     std::vector<std::string>& Glycans() { return glycans_; }
     std::vector<std::string>& Peptides() { return peptides_; }
-    virtual void set_glycans(const std::vector<std::string>& glycans) { glycans_ = glycans; }
+    virtual void set_glycans(const std::vector<std::string>& glycans)
+    {
+        glycans_ = glycans;
+        glycan_mass_.clear();
+        for(const auto& glycan : glycans_)
+        {
+            glycan_mass_.push_back(isomer_.QueryMass(glycan));
+        }
+        index_.Init(peptide_mass_, glycan_mass_);
+    }
     virtual void set_peptides(const std::vector<std::string>& peptides)
     {
-        std::vector<std::shared_ptr<algorithm::search::Point<std::string>>> points;
-        for(const auto& peptide : peptides)
+        peptides_ = peptides;
+        peptide_mass_.clear();
+        for(const auto& peptide : peptides_)
         {
-            double mass = util::mass::PeptideMass::Compute(peptide);
-            std::shared_ptr<algorithm::search::Point<std::string>> p = 
-                std::make_shared<algorithm::search::Point<std::string>>(mass, peptide);
-            points.push_back(std::move(p));
+            peptide_mass_.push_back(util::mass::PeptideMass::Compute(peptide));
         }
-        searcher_.set_data(std::move(points));
-        searcher_.Init();
+        decoy_begin_ = peptides_.size();
+        index_.Init(peptide_mass_, glycan_mass_);
     }
 
     double Tolerance() const { return tolerance_; }
     algorithm::search::ToleranceBy ToleranceType() const { return by_; }
     void set_tolerance(double tol) 
-        { tolerance_ = tol; searcher_.set_tolerance(tol); searcher_.Init(); }
+        { tolerance_ = tol; index_.set_tolerance(tol); }
     void set_tolerance_by(algorithm::search::ToleranceBy by) 
-        { by_ = by; searcher_.set_tolerance_by(by); searcher_.Init(); }
+        { by_ = by; index_.set_tolerance_by(by); }
 
     virtual MatchResultStore Match(const double target, int charge)
     {
@@ -106,25 +124,38 @@ public:
 
     virtual MatchResultStore Match(const double target, int charge, const int isotope)
     {
+        // candidates straight from the glycopeptide mass window
         MatchResultStore res;
-        if (searcher_.ToleranceType() == algorithm::search::ToleranceBy::PPM)
-            searcher_.set_base(target);
-        else if (searcher_.ToleranceType() == algorithm::search::ToleranceBy::Dalton)
-            searcher_.set_scale(charge);
-
-        for(const auto& glycan : glycans_)
+        for(const auto& it : index_.Query(target, charge, isotope))
         {
-            double delta = target - isomer_.QueryMass(glycan);
-            if (delta <= 0 ) continue;
+            res.Add(peptides_[it.peptide], glycans_[it.glycan]);
+        }
+        return res;
+    }
 
-            for (int i = 0; i <= isotope; i++)
+    // candidates of many precursors in one pass over the glycopeptide masses,
+    // result[j] equals Match(targets[j], charges[j], isotope).
+    std::vector<MatchResultStore> BatchMatch(const std::vector<double>& targets,
+        const std::vector<int>& charges, const int isotope)
+    {
+        std::vector<MatchResultStore> decoys;
+        return BatchMatch(targets, charges, isotope, decoys);
+    }
+
+    // the same over a joint index, candidates of decoy peptides go to decoys
+    std::vector<MatchResultStore> BatchMatch(const std::vector<double>& targets,
+        const std::vector<int>& charges, const int isotope, std::vector<MatchResultStore>& decoys)
+    {
+        std::vector<MatchResultStore> res(targets.size());
+        decoys.assign(targets.size(), MatchResultStore());
+        std::vector<std::vector<typename BasicGlycopeptideIndex<Policy>::Entry>> candidates =
+            index_.BatchQuery(targets, charges, isotope);
+        for(int j = 0; j < (int) targets.size(); j++)
+        {
+            for(const auto& it : candidates[j])
             {
-                double q = delta - i * util::mass::SpectrumMass::kIon;
-                std::vector<std::string> peptides = searcher_.Query(q);
-                for(const auto& peptide : peptides)
-                {
-                    res.Add(peptide, glycan);
-                }
+                MatchResultStore& store = it.peptide < decoy_begin_ ? res[j] : decoys[j];
+                store.Add(peptides_[it.peptide], glycans_[it.glycan]);
             }
         }
         return res;
@@ -133,13 +164,19 @@ public:
 protected:
     double tolerance_;
     algorithm::search::ToleranceBy by_;
-    algorithm::search::BasicSearch<std::string> searcher_;
+    BasicGlycopeptideIndex<Policy> index_;
     engine::glycan::GlycanStore isomer_;
     std::vector<std::string> glycans_;
+    std::vector<double> glycan_mass_;
     std::vector<std::string> peptides_;
+    std::vector<double> peptide_mass_;
+    // peptides from here on are decoys
+    int decoy_begin_ = 0;
 
 }; 
 
+typedef BasicPrecursorMatcher<algorithm::search::DynamicTolerance> PrecursorMatcher;
+
 } // namespace engine
 } // namespace search
 
@@ -0,0 +1,96 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <memory>
+#include "precursor_match.h"
+#include "../../algorithm/search/search.h"
+
+// latency of PrecursorMatcher::Match against the size of the peptide database,
+// with the raw window query over a sorted array, the former peptide lookup
+// of the matcher
+
+using namespace engine::search;
+
+std::vector<std::string> RandomPeptides(int size, std::mt19937& gen)
+{
+    const std::string residues = "ACDEFGHIKLMNPQRSTVWY";
+    std::uniform_int_distribution<int> length(6, 30), residue(0, residues.size() - 1);
+    std::vector<std::string> peptides;
+    for(int i = 0; i < size; i++)
+    {
+        std::string seq;
+        int n = length(gen);
+        for(int j = 0; j < n; j++)
+        {
+            seq += residues[residue(gen)];
+        }
+        peptides.push_back(seq);
+    }
+    return peptides;
+}
+
+template <class Searcher>
+double QueryLatency(Searcher& searcher, const std::vector<double>& target, int& found)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for(const auto& it : target)
+    {
+        found += searcher.Query(it).size();
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / target.size();
+}
+
+int main(int argc, char *argv[])
+{
+    std::unique_ptr<engine::glycan::NGlycanBuilder> builder =
+        std::make_unique<engine::glycan::NGlycanBuilder>(7, 8, 2, 2, 0);
+    builder->Build();
+    std::vector<std::string> glycans = builder->Isomer().Collection();
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> mass(1500.0, 6000.0);
+    std::vector<double> precursor(200), target(100000);
+    for(auto& it : precursor) it = mass(gen);
+    for(auto& it : target) it = mass(gen) - 1000.0;
+
+    int found = 0;
+    std::cout << "glycans: " << glycans.size() << std::endl;
+    std::cout << std::setw(10) << "peptides" << std::setw(14) << "Match (us)"
+        << std::setw(16) << "sorted (ns)" << std::endl;
+    for(int size = 1000; size <= 1000000; size *= 10)
+    {
+        std::vector<std::string> peptides = RandomPeptides(size, gen);
+        PrecursorMatcher matcher(10, algorithm::search::ToleranceBy::PPM, builder->Isomer());
+        matcher.Init(peptides, glycans);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for(const auto& it : precursor)
+        {
+            found += matcher.Match(it, 3, 2).Peptides().size();
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        double match = std::chrono::duration<double, std::micro>(stop - start).count() / precursor.size();
+
+        std::vector<std::shared_ptr<algorithm::search::Point<std::string>>> points;
+        for(const auto& peptide : peptides)
+        {
+            points.push_back(std::make_shared<algorithm::search::Point<std::string>>(
+                util::mass::PeptideMass::Compute(peptide), peptide));
+        }
+        algorithm::search::BasicSearch<std::string, algorithm::search::BasePPMTolerance>
+            sorted(10, algorithm::search::ToleranceBy::PPM);
+        sorted.set_data(points);
+        sorted.Init();
+        sorted.set_base(4000.0);
+
+        double sorted_time = QueryLatency(sorted, target, found);
+        std::cout << std::setw(10) << size << std::setw(14) << match
+            << std::setw(16) << sorted_time << std::endl;
+    }
+    std::cout << "checksum: " << found << std::endl;
+    return 0;
+}
@@ -10,11 +10,811 @@
 #include "../protein/protein_ptm.h"
 #include "../glycan/glycan_builder.h"
 #include "../spectrum/normalize.h"
+#include "../spectrum/deisotope.h"
+#include "../spectrum/oxonium_filter.h"
+#include "precursor_calibration.h"
+#include "fragment_store.h"
+#include "../spectrum/spectrum_cache.h"
+#include "../../apps/search/search_dispatcher.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
 #include <chrono> 
 
 namespace engine{
 namespace search {
 
+BOOST_AUTO_TEST_CASE( fragment_index_test ) 
+{
+    std::vector<std::string> peptides {"MVSHHNLTTGATLINE", "NLFLNHSE", "AANETTK"};
+    FragmentTable table;
+    table.Init(peptides, 2);
+    BOOST_CHECK(table.Size() == 3);
+    int id = table.ID("NLFLNHSE");
+    BOOST_CHECK(table.SlotEnd(id) - table.SlotBegin(id) == 1);
+    int slot = table.Slot(id, 4);
+    BOOST_CHECK(slot >= 0);
+    BOOST_CHECK(table.End(slot, FragmentType::NonePTM) - table.Begin(slot, FragmentType::NonePTM) == 14);
+
+    // spectrum with the singly charged backbone ions of NLFLNHSE
+    std::vector<double> ions = FragmentTable::ComputeNonePTMPeptideMass("NLFLNHSE", 4);
+    std::vector<model::spectrum::Peak> peaks;
+    for (const auto& mass : ions)
+    {
+        peaks.push_back(model::spectrum::Peak(util::mass::SpectrumMass::ComputeMZ(mass, 1), 1.0));
+    }
+    std::sort(peaks.begin(), peaks.end());
+    engine::spectrum::NeutralMass neutral;
+    neutral.Init(peaks, 2);
+
+    FragmentIndex index(0.01, algorithm::search::ToleranceBy::Dalton);
+    index.Init(table);
+    FragmentIndex::Workspace space;
+    std::vector<int> slots;
+    for (int s = 0; s < table.Slots(); s++)
+        slots.push_back(s);
+    std::vector<double> scores;
+    index.Score(neutral, peaks, slots, space, scores);
+    BOOST_CHECK(scores[slot] == (double) peaks.size());
+
+    // each series is half of the ions, and an index of one series only
+    // counts the peaks of its own ions
+    const double* middle = table.End(slot, FragmentType::NonePTM, IonSeries::BY);
+    BOOST_CHECK(middle == table.Begin(slot, FragmentType::NonePTM, IonSeries::CZ));
+    BOOST_CHECK(middle - table.Begin(slot, FragmentType::NonePTM, IonSeries::BY) == 7);
+    BOOST_CHECK(SeriesOf(model::spectrum::SpectrumType::HCD) == IonSeries::BY);
+    BOOST_CHECK(SeriesOf(model::spectrum::SpectrumType::EThcD) == IonSeries::All);
+    std::vector<model::spectrum::Peak> by_peaks;
+    for (int i = 0; i < 7; i++)
+    {
+        by_peaks.push_back(model::spectrum::Peak(util::mass::SpectrumMass::ComputeMZ(ions[i], 1), 1.0));
+    }
+    std::sort(by_peaks.begin(), by_peaks.end());
+    neutral.Init(by_peaks, 2);
+    FragmentIndex by_index(0.01, algorithm::search::ToleranceBy::Dalton);
+    by_index.Init(table, FragmentType::NonePTM, IonSeries::BY);
+    BOOST_CHECK(by_index.Series() == IonSeries::BY);
+    by_index.Score(neutral, by_peaks, slots, space, scores);
+    BOOST_CHECK(scores[slot] == 7.0);
+    FragmentIndex cz_index(0.01, algorithm::search::ToleranceBy::Dalton);
+    cz_index.Init(table, FragmentType::NonePTM, IonSeries::CZ);
+    cz_index.Score(neutral, by_peaks, slots, space, scores);
+    BOOST_CHECK(scores[slot] < 7.0);
+}
+
+BOOST_AUTO_TEST_CASE( fragment_store_test ) 
+{
+    std::vector<std::string> peptides {"MVSHHNLTTGATLINE", "NLFLNHSE", "AANETTK"};
+    FragmentStore store(0.01, algorithm::search::ToleranceBy::Dalton);
+    BOOST_CHECK(store.Empty());
+    store.Init(peptides, 2);
+    BOOST_CHECK(store.Holds(peptides));
+    BOOST_CHECK(!store.Holds({"NLFLNHSE"}));
+    BOOST_CHECK(store.Fits(0.01, algorithm::search::ToleranceBy::Dalton));
+    BOOST_CHECK(!store.Fits(10, algorithm::search::ToleranceBy::PPM));
+    BOOST_CHECK(store.Table().Size() == 3);
+
+    // indexes are built once per series, on demand
+    BOOST_CHECK(store.Index(IonSeries::BY) == nullptr);
+    store.Build(IonSeries::BY);
+    const FragmentIndex* index = store.Index(IonSeries::BY);
+    BOOST_CHECK(index != nullptr && index->Series() == IonSeries::BY);
+    store.Build(IonSeries::BY);
+    store.Build(IonSeries::All);
+    BOOST_CHECK(store.Index(IonSeries::BY) == index);
+    BOOST_CHECK(store.Index(IonSeries::All) != nullptr);
+    BOOST_CHECK(store.Index(IonSeries::CZ) == nullptr);
+
+    // a new peptide set drops the indexes of the former one
+    store.Init({"NLFLNHSE"}, 1);
+    BOOST_CHECK(store.Table().Size() == 1);
+    BOOST_CHECK(store.Index(IonSeries::BY) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE( batch_match_test ) 
+{
+    engine::glycan::NGlycanBuilder builder(4, 4, 1, 1, 0);
+    builder.Build();
+    std::vector<std::string> glycans = builder.Isomer().Collection();
+    std::vector<std::string> peptides {"MVSHHNLTTGATLINE", "NLFLNHSE", "AANETTK", "NETTKAA", "EVNKS"};
+
+    // precursors built from the candidates, some off by an isotope
+    std::vector<double> targets;
+    std::vector<int> charges;
+    for(int i = 0; i < (int) peptides.size(); i++)
+    {
+        for(int j = 0; j < (int) glycans.size(); j += 7)
+        {
+            targets.push_back(util::mass::PeptideMass::Compute(peptides[i]) 
+                + builder.Isomer().QueryMass(glycans[j]) + (i % 2) * util::mass::SpectrumMass::kIon);
+            charges.push_back(2 + j % 3);
+        }
+    }
+
+    for(const auto& by : {algorithm::search::ToleranceBy::PPM, algorithm::search::ToleranceBy::Dalton})
+    {
+        PrecursorMatcher matcher(by == algorithm::search::ToleranceBy::PPM ? 10 : 0.02, by, builder.Isomer());
+        matcher.Init(peptides, glycans);
+        std::vector<MatchResultStore> batch = matcher.BatchMatch(targets, charges, 2);
+        BOOST_CHECK(batch.size() == targets.size());
+        for(int j = 0; j < (int) targets.size(); j++)
+        {
+            MatchResultStore single = matcher.Match(targets[j], charges[j], 2);
+            BOOST_CHECK(!single.Empty());
+            BOOST_CHECK(batch[j].Peptides() == single.Peptides());
+            BOOST_CHECK(batch[j].Map() == single.Map());
+        }
+
+        // a joint index splits the candidates of targets and decoys
+        std::vector<std::string> decoys;
+        for(auto seq : peptides)
+        {
+            std::reverse(seq.begin(), seq.end());
+            decoys.push_back(seq);
+        }
+        PrecursorMatcher decoy_matcher(matcher.Tolerance(), by, builder.Isomer());
+        decoy_matcher.Init(decoys, glycans);
+        PrecursorMatcher joint_matcher(matcher.Tolerance(), by, builder.Isomer());
+        joint_matcher.Init(peptides, decoys, glycans);
+        std::vector<MatchResultStore> joint_decoy;
+        std::vector<MatchResultStore> joint = joint_matcher.BatchMatch(targets, charges, 2, joint_decoy);
+        std::vector<MatchResultStore> decoy = decoy_matcher.BatchMatch(targets, charges, 2);
+        for(int j = 0; j < (int) targets.size(); j++)
+        {
+            BOOST_CHECK(joint[j].Map() == batch[j].Map());
+            BOOST_CHECK(joint_decoy[j].Map() == decoy[j].Map());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( glycopeptide_index_test ) 
+{
+    engine::glycan::NGlycanBuilder builder(4, 4, 1, 1, 0);
+    builder.Build();
+    std::vector<std::string> glycans = builder.Isomer().Collection();
+    std::vector<std::string> peptides {"MVSHHNLTTGATLINE", "NLFLNHSE", "AANETTK", "NETTKAA", "EVNKS"};
+    std::vector<double> peptide_mass, glycan_mass;
+    for(const auto& it : peptides) peptide_mass.push_back(util::mass::PeptideMass::Compute(it));
+    for(const auto& it : glycans) glycan_mass.push_back(builder.Isomer().QueryMass(it));
+
+    std::vector<double> targets;
+    std::vector<int> charges;
+    for(int i = 0; i < (int) peptides.size(); i++)
+    {
+        for(int j = 0; j < (int) glycans.size(); j += 5)
+        {
+            targets.push_back(peptide_mass[i] + glycan_mass[j] + (j % 2) * util::mass::SpectrumMass::kIon);
+            charges.push_back(2 + j % 3);
+        }
+    }
+
+    // the full list and the lazy merge give the same candidates, in the same order
+    GlycopeptideIndex full(10, algorithm::search::ToleranceBy::PPM);
+    GlycopeptideIndex lazy(10, algorithm::search::ToleranceBy::PPM, 0);
+    full.Init(peptide_mass, glycan_mass);
+    lazy.Init(peptide_mass, glycan_mass);
+    BOOST_CHECK(full.Full());
+    BOOST_CHECK(!lazy.Full());
+    std::vector<std::vector<GlycopeptideIndex::Entry>> batch = lazy.BatchQuery(targets, charges, 1);
+    for(int j = 0; j < (int) targets.size(); j++)
+    {
+        std::vector<GlycopeptideIndex::Entry> expect = full.Query(targets[j], charges[j], 1);
+        std::vector<GlycopeptideIndex::Entry> single = lazy.Query(targets[j], charges[j], 1);
+        BOOST_CHECK(!expect.empty());
+        BOOST_CHECK(single.size() == expect.size());
+        BOOST_CHECK(batch[j].size() == expect.size());
+        for(int k = 0; k < (int) expect.size() && k < (int) single.size() && k < (int) batch[j].size(); k++)
+        {
+            BOOST_CHECK(single[k].peptide == expect[k].peptide && single[k].glycan == expect[k].glycan);
+            BOOST_CHECK(batch[j][k].peptide == expect[k].peptide && batch[j][k].glycan == expect[k].glycan);
+        }
+
+        // every candidate within 10 ppm, none missed
+        int count = 0;
+        for(int p = 0; p < (int) peptides.size(); p++)
+        {
+            for(int g = 0; g < (int) glycans.size(); g++)
+            {
+                for(int i = 0; i <= 1; i++)
+                {
+                    double q = targets[j] - glycan_mass[g] - i * util::mass::SpectrumMass::kIon;
+                    if (std::abs(peptide_mass[p] - q) / targets[j] * 1000000.0 < 10) count++;
+                }
+            }
+        }
+        BOOST_CHECK(count == (int) expect.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( result_collector_test ) 
+{
+    ResultCollector collector;
+    collector.SpectrumBase(std::vector<model::spectrum::Peak>{model::spectrum::Peak(500.0, 1.0)});
+    for(int i = 0; i < 30; i++)
+    {
+        collector.InitCollect();
+        collector.PeptideCollect((i * 7) % 30 + 1.0, 3);
+        collector.GlycanCollect(1.0, "isomer", SearchType::Core);
+        collector.Update(1, "PEPTIDE", "composite");
+    }
+
+    // the 20 best of 30, best first
+    std::vector<SearchResult> res = collector.Result();
+    BOOST_CHECK(res.size() == 20);
+    for(int i = 0; i < (int) res.size(); i++)
+    {
+        BOOST_CHECK(std::abs(res[i].RawScore() - std::sqrt(30.0 - i + 1.0)) < 1e-9);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( deisotope_test ) 
+{
+    // a doubly charged envelope of three peaks and a lone peak
+    double mass = 1500.0;
+    double mz = util::mass::SpectrumMass::ComputeMZ(mass, 2);
+    std::vector<model::spectrum::Peak> peaks {
+        model::spectrum::Peak(500.0, 5.0),
+        model::spectrum::Peak(mz + engine::spectrum::Deisotoper::kIsotope, 1.0),
+        model::spectrum::Peak(mz, 4.0),
+        model::spectrum::Peak(mz + engine::spectrum::Deisotoper::kIsotope / 2, 3.0)
+    };
+    engine::spectrum::Deisotoper deisotoper(0.01, algorithm::search::ToleranceBy::Dalton);
+    deisotoper.Transform(peaks, 3);
+    BOOST_CHECK(peaks.size() == 2);
+    BOOST_CHECK(deisotoper.Charges() == std::vector<int>({1, 2}));
+    BOOST_CHECK(peaks[0].MZ() == 500.0);
+    BOOST_CHECK(std::abs(peaks[1].MZ() - util::mass::SpectrumMass::ComputeMZ(mass, 1)) < 1e-9);
+    BOOST_CHECK(peaks[1].Intensity() == 8.0);
+
+    // without higher charges the envelope stays apart
+    peaks = {
+        model::spectrum::Peak(mz, 4.0),
+        model::spectrum::Peak(mz + engine::spectrum::Deisotoper::kIsotope / 2, 3.0)
+    };
+    deisotoper.Transform(peaks, 1);
+    BOOST_CHECK(peaks.size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE( oxonium_filter_test ) 
+{
+    // scans 1 and 3 hold an oxonium ion, singly and doubly charged
+    double hexnac = util::mass::GlycanMass::kHexNAc;
+    std::vector<model::spectrum::Spectrum> spectra(4);
+    std::vector<std::vector<model::spectrum::Peak>> peaks {
+        { model::spectrum::Peak(util::mass::SpectrumMass::ComputeMZ(hexnac, 1), 1.0),
+            model::spectrum::Peak(500.0, 2.0) },
+        { model::spectrum::Peak(300.0, 1.0), model::spectrum::Peak(500.0, 2.0) },
+        { model::spectrum::Peak(util::mass::SpectrumMass::ComputeMZ(hexnac, 2), 1.0) },
+        { model::spectrum::Peak(util::mass::SpectrumMass::ComputeMZ(hexnac, 2) + 0.5, 1.0) }
+    };
+    for(int i = 0; i < 4; i++)
+    {
+        spectra[i].set_peaks(peaks[i]);
+        spectra[i].set_scan(i + 1);
+        spectra[i].set_parent_charge(i < 2 ? 1 : 2);
+    }
+
+    engine::spectrum::OxoniumFilter filter(0.01, algorithm::search::ToleranceBy::Dalton);
+    BOOST_CHECK(filter.Contains(spectra[0]));
+    BOOST_CHECK(!filter.Contains(spectra[1]));
+    BOOST_CHECK(filter.Contains(spectra[2]));
+    BOOST_CHECK(!filter.Contains(spectra[3]));
+    BOOST_CHECK(filter.Filter(spectra) == 2);
+    BOOST_CHECK(spectra.size() == 2);
+    BOOST_CHECK(spectra[0].Scan() == 1 && spectra[1].Scan() == 3);
+
+    // a doubly charged ion is not looked for under a singly charged precursor
+    model::spectrum::Spectrum single;
+    single.set_peaks(peaks[2]);
+    single.set_parent_charge(1);
+    BOOST_CHECK(!filter.Contains(single));
+
+    // in ppm, and a matched peak without intensity does not count
+    engine::spectrum::OxoniumFilter ppm(10, algorithm::search::ToleranceBy::PPM);
+    BOOST_CHECK(ppm.Contains(spectra[0]));
+    std::vector<model::spectrum::Peak> empty {
+        model::spectrum::Peak(util::mass::SpectrumMass::ComputeMZ(hexnac, 1), 0.0) };
+    single.set_peaks(empty);
+    BOOST_CHECK(!ppm.Contains(single));
+}
+
+BOOST_AUTO_TEST_CASE( spectrum_cache_test ) 
+{
+    std::vector<model::spectrum::Spectrum> spectra(2);
+    for (int k = 0; k < 2; k++)
+    {
+        std::vector<model::spectrum::Peak> peaks {
+            model::spectrum::Peak(204.087 + k, 3.0), model::spectrum::Peak(500.25, 1.0 + k)
+        };
+        spectra[k].set_peaks(peaks);
+        spectra[k].set_scan(10 + k);
+        spectra[k].set_type(model::spectrum::SpectrumType::HCD);
+        spectra[k].set_parent_mz(800.5);
+        spectra[k].set_parent_charge(2 + k);
+    }
+    engine::spectrum::SpectrumCache cache(0.01, algorithm::search::ToleranceBy::Dalton, false);
+    cache.Init(spectra, 2);
+    BOOST_CHECK(cache.Size() == 2);
+    BOOST_CHECK(cache.Find(12) == nullptr);
+    const engine::spectrum::PreprocessedSpectrum* spectrum = cache.Find(11);
+    BOOST_CHECK(spectrum->Neutral().MaxCharge() == 3);
+    BOOST_CHECK(std::abs(spectrum->PeakValue() - (60.0 * 60.0 + 40.0 * 40.0)) < 1e-9);
+
+    // saved and read back as is, but not under another tolerance
+    std::string source = "spectrum_cache_test.mgf";
+    std::ofstream(source) << "BEGIN IONS\nEND IONS\n";
+    std::string path = engine::spectrum::SpectrumCache::PathOf(source);
+    BOOST_CHECK(cache.Save(path, source));
+    engine::spectrum::SpectrumCache loaded(0.01, algorithm::search::ToleranceBy::Dalton, false);
+    BOOST_CHECK(loaded.Load(path, source));
+    const engine::spectrum::PreprocessedSpectrum* copy = loaded.Find(11);
+    BOOST_CHECK(copy != nullptr);
+    BOOST_CHECK(copy->PeakValue() == spectrum->PeakValue());
+    BOOST_CHECK(copy->Neutral().Size() == 2);
+    BOOST_CHECK(std::equal(copy->Neutral().Mass(3), copy->Neutral().Mass(3) + 2, spectrum->Neutral().Mass(3)));
+    model::spectrum::Spectrum spec = copy->Spectrum();
+    BOOST_CHECK(spec.Type() == model::spectrum::SpectrumType::HCD);
+    BOOST_CHECK(spec.Peaks()[1].Intensity() == 40.0);
+    engine::spectrum::SpectrumCache other(0.02, algorithm::search::ToleranceBy::Dalton, false);
+    BOOST_CHECK(!other.Load(path, source));
+    BOOST_CHECK(other.Empty());
+
+    // nor once the spectrum file is replaced, or the cache cut short
+    std::ofstream(source) << "BEGIN IONS\nTITLE=replaced\nEND IONS\n";
+    BOOST_CHECK(!loaded.Load(path, source));
+    BOOST_CHECK(loaded.Empty());
+    BOOST_CHECK(cache.Save(path, source));
+    BOOST_CHECK(loaded.Load(path, source));
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream(path, std::ios::binary) << bytes.substr(0, bytes.size() / 2);
+    BOOST_CHECK(!loaded.Load(path, source));
+    std::remove(path.c_str());
+    std::remove(source.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( precursor_calibration_test ) 
+{
+    // error growing with m/z, a little noise and a few wrong matches
+    PrecursorCalibration calibration;
+    for (int i = 0; i < 100; i++)
+    {
+        double mz = 800.0 + i * 10.0;
+        calibration.Add(mz, 3.0 + 0.002 * mz + ((i % 5) - 2) * 0.1);
+    }
+    calibration.Add(1000.0, -9.0);
+    calibration.Add(1200.0, 9.5);
+    BOOST_CHECK(calibration.Fit());
+    BOOST_CHECK(std::abs(calibration.Slope() - 0.002) < 1e-4);
+    BOOST_CHECK(std::abs(calibration.Error(1000.0) - 5.0) < 0.1);
+    BOOST_CHECK(calibration.Tolerance(10.0) == PrecursorCalibration::kMinTolerance);
+
+    double mass = 3000.0;
+    double mz = util::mass::SpectrumMass::ComputeMZ(mass * (1 + calibration.Error(1000.0) / 1000000.0), 3);
+    double corrected = util::mass::SpectrumMass::Compute(calibration.Correct(mz, 3), 3);
+    BOOST_CHECK(std::abs(corrected - mass) / mass * 1000000.0 < 0.01);
+
+    // few matches take their median, too few none
+    PrecursorCalibration few;
+    for (int i = 0; i < 12; i++)
+        few.Add(900.0 + i, i < 6 ? 4.0 : 6.0);
+    BOOST_CHECK(few.Fit());
+    BOOST_CHECK(few.Slope() == 0 && few.Offset() == 5.0);
+    PrecursorCalibration none;
+    none.Add(900.0, 4.0);
+    BOOST_CHECK(!none.Fit());
+    BOOST_CHECK(none.Tolerance(10.0) == 10.0);
+
+    // signed error of a monoisotopic match, and the 13C peak of another
+    double match = util::mass::PeptideMass::Compute("AANETTK") 
+        + util::mass::GlycanMass::Compute(model::glycan::Glycan::Interpret("GlcNAc-2-Man-3-"));
+    int isotope;
+    double error = PrecursorCalibration::MatchError("AANETTK", "GlcNAc-2-Man-3-", 
+        match * (1 + 5.0 / 1000000.0), 2, isotope);
+    BOOST_CHECK(isotope == 0 && std::abs(error - 5.0) < 1e-6);
+    PrecursorCalibration::MatchError("AANETTK", "GlcNAc-2-Man-3-", 
+        match + util::mass::SpectrumMass::kIsotope, 2, isotope);
+    BOOST_CHECK(isotope == 1);
+
+    // with isotopes searched the window keeps the kIon step offset
+    double skew = (util::mass::SpectrumMass::kIon - util::mass::SpectrumMass::kIsotope) / 1500.0 * 1000000.0;
+    BOOST_CHECK(std::abs(calibration.Tolerance(20.0, 1, 1500.0) - (PrecursorCalibration::kMinTolerance + skew)) < 1e-9);
+    BOOST_CHECK(calibration.Tolerance(4.0, 2, 1500.0) == 4.0);
+}
+
+// spectrum of a glycopeptide: oxonium ions, the backbone ions of the peptide
+// and the Y ions of the core, branch and terminal subsets of the glycan, under
+// a higher charge as a monoisotopic peak and its 13C peak
+model::spectrum::Spectrum GlycopeptideSpectrum(engine::glycan::NGlycanBuilder& builder,
+    const std::string& peptide, const std::string& composite, int scan, int y_charge = 1)
+{
+    std::vector<model::spectrum::Peak> peaks;
+    for(const auto& mass : engine::spectrum::OxoniumFilter::Ions())
+    {
+        peaks.push_back(model::spectrum::Peak(util::mass::SpectrumMass::ComputeMZ(mass, 1), 2.0));
+    }
+    int pos = engine::protein::ProteinPTM::FindNGlycanSite(peptide).front();
+    for(const auto& mass : FragmentTable::ComputeNonePTMPeptideMass(peptide, pos))
+    {
+        peaks.push_back(model::spectrum::Peak(util::mass::SpectrumMass::ComputeMZ(mass, 1), 1.0));
+    }
+    double peptide_mass = util::mass::PeptideMass::Compute(peptide);
+    std::string isomer = *builder.Isomer().Query(composite).begin();
+    for(const auto& store : {builder.Core(), builder.Branch(), builder.Terminal()})
+    {
+        for(const auto& mass : store.Query(isomer))
+        {
+            double mz = util::mass::SpectrumMass::ComputeMZ(peptide_mass + mass, y_charge);
+            peaks.push_back(model::spectrum::Peak(mz, 1.5));
+            if (y_charge > 1)
+                peaks.push_back(model::spectrum::Peak(
+                    mz + engine::spectrum::Deisotoper::kIsotope / y_charge, 1.0));
+        }
+    }
+    std::sort(peaks.begin(), peaks.end());
+
+    model::spectrum::Spectrum spec;
+    spec.set_peaks(peaks);
+    spec.set_scan(scan);
+    spec.set_type(model::spectrum::SpectrumType::EThcD);
+    spec.set_parent_charge(2);
+    spec.set_parent_mz(util::mass::SpectrumMass::ComputeMZ(
+        peptide_mass + builder.Isomer().QueryMass(composite), 2));
+    engine::spectrum::Normalizer::Transform(spec);
+    return spec;
+}
+
+// the candidates of the spectrum searches: every peptide, and every decoy,
+// with every composition, and the fragment table and index of them all
+struct CandidateFixture
+{
+    CandidateFixture(): builder(4, 4, 1, 1, 0),
+        index(0.01, algorithm::search::ToleranceBy::Dalton)
+    {
+        builder.Build();
+        glycans = builder.Isomer().Collection();
+        std::vector<std::string> all(peptides);
+        all.insert(all.end(), decoys.begin(), decoys.end());
+        table.Init(all, 2);
+        index.Init(table);
+        for(const auto& glycan : glycans)
+        {
+            for(const auto& peptide : peptides)
+                candidate.Add(peptide, glycan);
+            for(const auto& peptide : decoys)
+                decoy_candidate.Add(peptide, glycan);
+        }
+    }
+
+    // a dalton searcher on the table and index
+    void Prepare(SpectrumSearcher& spectrum_runner)
+    {
+        spectrum_runner.Init();
+        spectrum_runner.set_table(&table);
+        spectrum_runner.set_index(&index);
+    }
+
+    engine::glycan::NGlycanBuilder builder;
+    std::vector<std::string> glycans;
+    std::vector<std::string> peptides {"MVSHHNLTTGATLINE", "NLFLNHSE", "AANETTK"};
+    std::vector<std::string> decoys {"NETTKAA"};
+    FragmentTable table;
+    FragmentIndex index;
+    MatchResultStore candidate, decoy_candidate;
+};
+
+BOOST_FIXTURE_TEST_CASE( pruning_test, CandidateFixture ) 
+{
+    // one of the candidates in the spectrum
+    for(int k = 0; k < (int) glycans.size(); k += 5)
+    {
+        model::spectrum::Spectrum spec = GlycopeptideSpectrum(builder, "NLFLNHSE", glycans[k], k);
+        std::vector<SearchResult> res[2];
+        long pruned[2];
+        for(int prune = 0; prune < 2; prune++)
+        {
+            SpectrumSearcher spectrum_runner(0.01, algorithm::search::ToleranceBy::Dalton, 0, &builder, false);
+            Prepare(spectrum_runner);
+            spectrum_runner.set_prune(prune == 1);
+            spectrum_runner.set_candidate(candidate);
+            spectrum_runner.set_spectrum(spec);
+            res[prune] = spectrum_runner.Search();
+            pruned[prune] = spectrum_runner.Pruned();
+        }
+        BOOST_CHECK(!res[1].empty());
+        BOOST_CHECK(pruned[0] == 0);
+        BOOST_CHECK(pruned[1] > 0);
+        BOOST_CHECK(res[0].size() == res[1].size());
+        for(int i = 0; i < (int) std::min(res[0].size(), res[1].size()); i++)
+        {
+            BOOST_CHECK(res[0][i].Sequence() == res[1][i].Sequence());
+            BOOST_CHECK(res[0][i].Glycan() == res[1][i].Glycan());
+            BOOST_CHECK(res[0][i].RawScore() == res[1][i].RawScore());
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE( joint_search_test, CandidateFixture ) 
+{
+    // one searcher for both halves against one for each
+    SpectrumSearcher joint_runner(0.01, algorithm::search::ToleranceBy::Dalton, 0, &builder, false);
+    SpectrumSearcher target_runner(0.01, algorithm::search::ToleranceBy::Dalton, 0, &builder, false);
+    SpectrumSearcher decoy_runner(0.01, algorithm::search::ToleranceBy::Dalton, 0, &builder, true);
+    for(auto runner : {&joint_runner, &target_runner, &decoy_runner})
+    {
+        Prepare(*runner);
+    }
+    auto same = [](const std::vector<SearchResult>& a, const std::vector<SearchResult>& b)
+    {
+        if (a.size() != b.size()) return false;
+        for(int i = 0; i < (int) a.size(); i++)
+        {
+            if (a[i].Sequence() != b[i].Sequence() || a[i].Glycan() != b[i].Glycan() ||
+                a[i].RawScore() != b[i].RawScore())
+                return false;
+        }
+        return true;
+    };
+    for(int k = 0; k < (int) glycans.size(); k += 5)
+    {
+        // a spectrum of a target, then of a decoy
+        for(const auto& peptide : {peptides[1], decoys.front()})
+        {
+            model::spectrum::Spectrum spec = GlycopeptideSpectrum(builder, peptide, glycans[k], k);
+            std::vector<SearchResult> joint_target, joint_decoy;
+            joint_runner.set_candidate(candidate);
+            joint_runner.set_spectrum(spec);
+            joint_runner.JointSearch(decoy_candidate, joint_target, joint_decoy);
+
+            target_runner.set_candidate(candidate);
+            target_runner.set_spectrum(spec);
+            decoy_runner.set_candidate(decoy_candidate);
+            decoy_runner.set_spectrum(spec);
+            std::vector<SearchResult> target = target_runner.Search();
+            std::vector<SearchResult> decoy = decoy_runner.Search();
+            BOOST_CHECK(!(peptide == peptides[1] ? target : decoy).empty());
+            BOOST_CHECK(same(joint_target, target));
+            BOOST_CHECK(same(joint_decoy, decoy));
+        }
+    }
+    // the candidates of the joint searcher are left as they were
+    BOOST_CHECK(joint_runner.Candidate().Map() == candidate.Map());
+}
+
+BOOST_FIXTURE_TEST_CASE( y_gate_test, CandidateFixture ) 
+{
+    // only the peptide of the spectrum has its Y1 ion, the others are gated
+    const int spectra = 3;
+    std::vector<SearchResult> res[2];
+    long gated[2];
+    for(int gate = 0; gate < 2; gate++)
+    {
+        SpectrumSearcher spectrum_runner(0.01, algorithm::search::ToleranceBy::Dalton, 0, &builder, false);
+        Prepare(spectrum_runner);
+        spectrum_runner.set_y_gate(gate == 1);
+        spectrum_runner.set_candidate(candidate);
+        for(int k = 0; k < spectra; k++)
+        {
+            spectrum_runner.set_spectrum(GlycopeptideSpectrum(builder, "NLFLNHSE", glycans[k * 5], k));
+            std::vector<SearchResult> r = spectrum_runner.Search();
+            res[gate].insert(res[gate].end(), r.begin(), r.end());
+        }
+        gated[gate] = spectrum_runner.Gated();
+    }
+    BOOST_CHECK(gated[0] == 0);
+    BOOST_CHECK(gated[1] == spectra * 2);
+    BOOST_CHECK(!res[1].empty());
+    BOOST_CHECK(res[0].size() == res[1].size());
+    for(int i = 0; i < (int) std::min(res[0].size(), res[1].size()); i++)
+    {
+        BOOST_CHECK(res[0][i].Sequence() == res[1][i].Sequence());
+        BOOST_CHECK(res[0][i].Glycan() == res[1][i].Glycan());
+    }
+
+    // a Y0 read 5 ppm light and no Y1 still opens the gate, in Dalton and in ppm
+    double peptide_mass = util::mass::PeptideMass::Compute("NLFLNHSE");
+    std::vector<model::spectrum::Peak> peaks;
+    for(const auto& mass : engine::spectrum::OxoniumFilter::Ions())
+    {
+        peaks.push_back(model::spectrum::Peak(util::mass::SpectrumMass::ComputeMZ(mass, 1), 1.0));
+    }
+    peaks.push_back(model::spectrum::Peak(
+        util::mass::SpectrumMass::ComputeMZ(peptide_mass * (1 - 5e-6), 1), 1.0));
+    model::spectrum::Spectrum light;
+    light.set_peaks(peaks);
+    light.set_scan(1);
+    light.set_parent_charge(2);
+    light.set_parent_mz(util::mass::SpectrumMass::ComputeMZ(peptide_mass + 1000.0, 2));
+    light.set_type(model::spectrum::SpectrumType::EThcD);
+    for(const auto& by : {algorithm::search::ToleranceBy::Dalton, algorithm::search::ToleranceBy::PPM})
+    {
+        SpectrumSearcher spectrum_runner(by == algorithm::search::ToleranceBy::PPM ? 10 : 0.01, 
+            by, 0, &builder, false);
+        spectrum_runner.Init();
+        spectrum_runner.set_table(&table);
+        spectrum_runner.set_y_gate(true);
+        spectrum_runner.set_candidate(candidate);
+        spectrum_runner.set_spectrum(light);
+        spectrum_runner.Search();
+        BOOST_CHECK(spectrum_runner.Gated() == 2);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE( top_k_test, CandidateFixture ) 
+{
+    // every candidate kept, as many as there are, or the few best; the first
+    // two are the same search, the best few still hold the peptide searched
+    const int top_k[3] = {0, (int) (peptides.size() * glycans.size()), 10};
+    std::vector<SearchResult> res[3];
+    for(int k = 0; k < 3; k++)
+    {
+        SpectrumSearcher spectrum_runner(0.01, algorithm::search::ToleranceBy::Dalton, 0, &builder, false);
+        Prepare(spectrum_runner);
+        spectrum_runner.set_top_k(top_k[k]);
+        spectrum_runner.set_candidate(candidate);
+        for(int j = 0; j < (int) glycans.size(); j += 5)
+        {
+            spectrum_runner.set_spectrum(GlycopeptideSpectrum(builder, "NLFLNHSE", glycans[j], j));
+            std::vector<SearchResult> r = spectrum_runner.Search();
+            BOOST_CHECK(!r.empty());
+            res[k].insert(res[k].end(), r.begin(), r.end());
+        }
+    }
+    BOOST_CHECK(res[0].size() == res[1].size());
+    for(int i = 0; i < (int) std::min(res[0].size(), res[1].size()); i++)
+    {
+        BOOST_CHECK(res[0][i].Glycan() == res[1][i].Glycan());
+        BOOST_CHECK(res[0][i].RawScore() == res[1][i].RawScore());
+    }
+    for(const auto& it : res[2])
+    {
+        BOOST_CHECK(it.Sequence() == "NLFLNHSE");
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE( deisotoped_search_test, CandidateFixture ) 
+{
+    // the Y ions only as doubly charged envelopes, collapsed to singly charged
+    // peaks they are matched under charge 1
+    std::string composite;
+    for(const auto& glycan : glycans)
+    {
+        if (glycan.find("Man-3-") != std::string::npos)
+        {
+            composite = glycan;
+            break;
+        }
+    }
+    model::spectrum::Spectrum spec = GlycopeptideSpectrum(builder, "NLFLNHSE", composite, 1, 2);
+    model::spectrum::Spectrum collapsed = spec;
+    engine::spectrum::Deisotoper deisotoper(0.01, algorithm::search::ToleranceBy::Dalton);
+    deisotoper.Transform(collapsed);
+    BOOST_CHECK(collapsed.Peaks().size() < spec.Peaks().size());
+    BOOST_CHECK(std::count(deisotoper.Charges().begin(), deisotoper.Charges().end(), 2) > 0);
+
+    SpectrumSearcher spectrum_runner(0.01, algorithm::search::ToleranceBy::Dalton, 0, &builder, false);
+    Prepare(spectrum_runner);
+    spectrum_runner.set_deisotoped(true);
+    spectrum_runner.set_candidate(candidate);
+    spectrum_runner.set_spectrum(collapsed);
+    std::vector<SearchResult> res = spectrum_runner.Search();
+    BOOST_REQUIRE(!res.empty());
+    BOOST_CHECK(res.front().Sequence() == "NLFLNHSE");
+    BOOST_CHECK(res.front().Glycan() == composite);
+
+    // left apart, the envelopes match under charge 2 only
+    spectrum_runner.set_spectrum(spec);
+    res = spectrum_runner.Search();
+    BOOST_CHECK(res.empty() || res.front().Glycan() != composite);
+    spectrum_runner.set_deisotoped(false);
+    spectrum_runner.set_spectrum(spec);
+    res = spectrum_runner.Search();
+    BOOST_REQUIRE(!res.empty());
+    BOOST_CHECK(res.front().Glycan() == composite);
+}
+
+// the dispatcher with the spectra it searches, precursors recalibrated, in view
+class CalibratedDispatcher : public SearchDispatcher
+{
+public:
+    using SearchDispatcher::SearchDispatcher;
+    std::vector<model::spectrum::Spectrum>& Searched() { return spectra_; }
+};
+
+BOOST_FIXTURE_TEST_CASE( recalibrate_test, CandidateFixture ) 
+{
+    // precursors read 8 ppm heavy. The pass samples the even spectra, half of
+    // them strong and half weakened by noise, two of the strong ones matched
+    // at their 13C peak; the odd ones are decoys and targets, two of them 18 ppm
+    // heavy, which the narrowed tolerance leaves out once corrected; the
+    // glycans planted have their whole core
+    const int n = 48;
+    std::vector<std::string> planted;
+    for(const auto& glycan : glycans)
+    {
+        if (glycan.find("Man-3-") != std::string::npos)
+            planted.push_back(glycan);
+    }
+    std::vector<model::spectrum::Spectrum> spectra;
+    std::vector<std::string> peptide(n), composite(n);
+    std::vector<double> offset(n, 8.0);
+    offset[1] = offset[3] = 18.0;
+    for(int i = 0; i < n; i++)
+    {
+        peptide[i] = i % 2 == 0 ? peptides[(i / 2) % peptides.size()] : 
+            (i % 4 == 1 ? decoys.front() : peptides[i % 3]);
+        composite[i] = planted[(i * 7) % planted.size()];
+        model::spectrum::Spectrum spec = GlycopeptideSpectrum(builder, peptide[i], composite[i], i);
+        double mass = util::mass::PeptideMass::Compute(peptide[i]) + 
+            builder.Isomer().QueryMass(composite[i]);
+        if (i == 0 || i == 4)
+            mass += util::mass::SpectrumMass::kIsotope;
+        spec.set_parent_mz(util::mass::SpectrumMass::ComputeMZ(mass * (1 + offset[i] / 1000000.0), 2));
+        if (i % 4 == 2)
+        {
+            std::vector<model::spectrum::Peak> peaks = spec.Peaks();
+            for(int j = 0; j < 10; j++)
+            {
+                peaks.push_back(model::spectrum::Peak(2000.37 + 13.71 * j, 20.0));
+            }
+            std::sort(peaks.begin(), peaks.end());
+            spec.set_peaks(peaks);
+            engine::spectrum::Normalizer::Transform(spec);
+        }
+        spectra.push_back(spec);
+    }
+
+    SearchParameter parameter;
+    parameter.n_thread = 2;
+    parameter.ms1_tol = 20;
+    parameter.isotopic_count = 1;
+    parameter.recalibrate = true;
+    parameter.calibration_sample = n / 2;
+    CalibratedDispatcher dispatcher(spectra, &builder, peptides, decoys, parameter);
+    std::vector<SearchResult> targets, decoy_results;
+    dispatcher.JointDispatch(targets, decoy_results);
+
+    // every other spectrum, the strong half, at the monoisotopic peak
+    const PrecursorCalibration& calibration = dispatcher.Calibration();
+    BOOST_CHECK(calibration.Fitted());
+    BOOST_CHECK(calibration.Size() == n / 4 - 2);
+    BOOST_CHECK(std::abs(calibration.Offset() - 8.0) < 1e-3);
+    BOOST_CHECK(dispatcher.PrecursorTolerance() < 5.0);
+
+    // the spectra are searched at their corrected precursor
+    BOOST_CHECK(dispatcher.Searched().size() == spectra.size());
+    for(auto& spec : dispatcher.Searched())
+    {
+        BOOST_CHECK(std::abs(spec.PrecursorMZ() - 
+            calibration.Correct(spectra[spec.Scan()].PrecursorMZ(), 2)) < 1e-9);
+    }
+
+    // each spectrum matched as planted, targets and decoys, but for the ones
+    // outside the narrowed tolerance
+    std::vector<const SearchResult*> best(n, nullptr);
+    for(const auto& results : {&targets, &decoy_results})
+    {
+        for(const auto& it : *results)
+        {
+            const SearchResult*& b = best[it.Scan()];
+            if (b == nullptr || b->RawScore() < it.RawScore())
+                b = &it;
+        }
+    }
+    for(int i = 0; i < n; i++)
+    {
+        if (offset[i] > 8.0)
+        {
+            BOOST_CHECK(best[i] == nullptr);
+            continue;
+        }
+        BOOST_REQUIRE(best[i] != nullptr);
+        BOOST_CHECK(best[i]->Sequence() == peptide[i]);
+        BOOST_CHECK(best[i]->Glycan() == composite[i]);
+    }
+}
+
 BOOST_AUTO_TEST_CASE( search_engine_test ) 
 {
     // read spectrum
@@ -84,8 +884,14 @@ BOOST_AUTO_TEST_CASE( search_engine_test )
     std::vector<std::string> glycans_str = builder->Isomer().Collection();
     precursor_runner.Init(peptides, glycans_str);
 
+    FragmentTable table;
+    table.Init(peptides, 2);
+    FragmentIndex index(ms2_tol, ms2_by);
+    index.Init(table);
     SpectrumSearcher spectrum_runner(ms2_tol, ms2_by, 2, builder.get(), true);
     spectrum_runner.Init();
+    spectrum_runner.set_table(&table);
+    spectrum_runner.set_index(&index);
 
     auto special_spec = spectrum_reader.GetSpectrum(special_scan);
     double special_target = util::mass::SpectrumMass::Compute(special_spec.PrecursorMZ(), special_spec.PrecursorCharge());
@@ -7,6 +7,7 @@
 #include <unordered_map>
 #include <cmath> 
 #include <numeric>
+#include <algorithm>
 #include "../../model/spectrum/spectrum.h"
 #include "../../util/mass/glycan.h"
 #include "../../util/mass/peptide.h"
@@ -22,17 +23,13 @@ enum class ScoreType { Precursor, Elution };
 class SearchResult
 {
 public:
-    SearchResult(): score_(5, 0.0){}; // Core, Branch, Terminal, Oxonium, Peptide
+    SearchResult(): score_(5, 0.0), raw_score_(0.0){}; // Core, Branch, Terminal, Oxonium, Peptide
 
     int Scan() const { return scan_; }
     int ModifySite() const { return pos_; }
     std::string Sequence() const { return peptide_; }
     std::string Glycan() const { return glycan_; }
-    const double RawScore() const 
-    { 
-        if (score_.size() == 0) return 0.0;
-        return std::sqrt(std::accumulate(score_.begin(), score_.end(), 0.0));
-    }
+    const double RawScore() const { return raw_score_; }
     const double Value() const { return value_; }
     const std::vector<double> Score() const { return score_; }
 
@@ -47,7 +44,11 @@ public:
     void set_site(int pos) { pos_ = pos; }
     void set_peptide(std::string seq) { peptide_ = seq; }
     void set_glycan(std::string glycan) { glycan_ = glycan; }
-    void set_score(std::vector<double> score) { score_ = score; }
+    void set_score(std::vector<double> score) 
+    { 
+        score_ = score; 
+        raw_score_ = std::sqrt(std::accumulate(score_.begin(), score_.end(), 0.0));
+    }
     void set_value(double value) { value_ = value; }
     void set_extra(double score, ScoreType type) { extra_[type] = score; }
 
@@ -84,6 +85,7 @@ protected:
     std::string glycan_;
     int pos_;
     std::vector<double> score_;
+    double raw_score_;
     double value_;
     std::map<ScoreType, double> extra_;
     
@@ -94,17 +96,12 @@ class ResultCollector{
 public:
     ResultCollector(): best_(0.0), oxonium_(0){}
 
+    // hits by raw score, at most max_hits of them from Update
     std::vector<SearchResult> Result()
     {
-        // remove if hits over 20
-        if ((int) results_.size() > max_hits)
-        {
-            std::sort(results_.begin(), results_.end(), 
-                [](const SearchResult& r1, const SearchResult& r2) -> bool { return r1.RawScore() > r1.RawScore(); });
-            results_.erase(results_.begin() + max_hits, results_.end());
-        }
-
-        return results_;
+        std::vector<SearchResult> res(results_);
+        std::stable_sort(res.begin(), res.end(), ScoreGreater);
+        return res;
     }
     std::vector<SearchResult> BestResult()
     {
@@ -145,6 +142,7 @@ public:
         }
         return res;
     }
+    // keep the max_hits best, results_ is a min-heap on the raw score
     void Update(int scan, const std::string& sequence, const std::string& composite)
     {
         for(const auto& pos_it : peptide_)
@@ -153,6 +151,12 @@ public:
             std::vector<double> score = ComputeScore(pos_it.second);
             // emplace results
             Emplace(scan, sequence, composite, pos_it.first, score);
+            std::push_heap(results_.begin(), results_.end(), ScoreGreater);
+            if ((int) results_.size() > max_hits)
+            {
+                std::pop_heap(results_.begin(), results_.end(), ScoreGreater);
+                results_.pop_back();
+            }
         }
     }
 
@@ -178,6 +182,7 @@ public:
     {
         spectrum_ = SearchResult::PeakValue(spectrum_peaks);
     }
+    void SpectrumBase(double peak_value) { spectrum_ = peak_value; }
     void InitCollect()
     {
         peptide_.clear(); 
@@ -198,6 +203,13 @@ public:
             peptide_[pos] = SearchResult::PeakValue(peptide_peaks);
         }
     }
+    void PeptideCollect(double peptide_score, int pos)
+    {
+        if (peptide_score > 0)
+        {
+            peptide_[pos] = peptide_score;
+        }
+    }
     void GlycanCollect(const std::vector<model::spectrum::Peak>& glycan_peaks, 
         std::string isomer, SearchType type)
     {
@@ -210,6 +222,8 @@ public:
                     break;
                 case SearchType::Branch:
                     glycan_branch_[isomer] =  SearchResult::PeakValue(glycan_peaks);
+                    // fall through: the branch score stands for the terminal
+                    // until a terminal score is collected
                 case SearchType::Terminal:
                     glycan_terminal_[isomer] = SearchResult::PeakValue(glycan_peaks);
                 default:
@@ -217,6 +231,25 @@ public:
             }
         }
     }
+    void GlycanCollect(double glycan_score, std::string isomer, SearchType type)
+    {
+        if (glycan_score > 0)
+        {
+            switch (type)
+            {
+                case SearchType::Core:
+                    glycan_core_[isomer] = glycan_score;
+                    break;
+                case SearchType::Branch:
+                    glycan_branch_[isomer] = glycan_score;
+                    // fall through, as above; GlycanBound counts on it
+                case SearchType::Terminal:
+                    glycan_terminal_[isomer] = glycan_score;
+                default:
+                    break;
+            }
+        }
+    }
     void PrecursorCollect(double precursor_mass, int isotopic)
     {
         precursor_mass_ = precursor_mass;
@@ -235,9 +268,32 @@ public:
     {
         return glycan_core_.empty();
     }
+    // the best score the candidate could still reach, given an upper bound
+    // of its glycan scores, is below the best kept so far or the floor, a
+    // score another candidate is known to reach
+    bool BoundMiss(double glycan_bound, double floor = 0)
+    {
+        double best = results_.empty() ? floor : std::max(best_, floor);
+        if (best <= 0) return false;
+        // scores are summed in another order, keep ties
+        return TotalScore(glycan_bound) < best * (1 - 1e-9);
+    }
+    // the total score given the glycan scores, at the best site
+    double TotalScore(double glycan_score)
+    {
+        double peptide_score = 0;
+        for(const auto& it : peptide_)
+        {
+            peptide_score = std::max(peptide_score, it.second);
+        }
+        return (glycan_score + oxonium_ + peptide_score) / spectrum_;
+    }
     bool Empty() { return results_.empty(); }
 
 protected:
+    static bool ScoreGreater(const SearchResult& r1, const SearchResult& r2)
+        { return r1.RawScore() > r2.RawScore(); }
+
     std::vector<double> ComputeScore(double peptide_score)
     {
         double score = 0;
@@ -6,33 +6,41 @@
 #include <unordered_map>
 #include <memory>
 #include <algorithm>
+#include <numeric>
 #include "precursor_match.h"
 #include "search_result.h"
+#include "fragment_table.h"
+#include "fragment_index.h"
 
-#include "../../algorithm/search/bucket_search.h"
-#include "../../algorithm/search/binary_search.h"
+#include "../../algorithm/search/bitmap_search.h"
 #include "../../util/mass/peptide.h"
 #include "../../model/glycan/glycan.h"
 #include "../../model/spectrum/spectrum.h"
 #include "../../util/mass/glycan.h"
 #include "../../util/mass/spectrum.h"
 #include "../../util/mass/ion.h"
+#include "../../util/calc/simd.h"
 #include "../../engine/glycan/glycan_builder.h"
 #include "../../engine/protein/protein_ptm.h"
+#include "../../engine/spectrum/neutral_mass.h"
+#include "../../engine/spectrum/spectrum_cache.h"
+#include "../../engine/spectrum/oxonium_filter.h"
 
 #include <iostream>
 
 namespace engine{
 namespace search{
 
-class SpectrumSearcher
+// fragment ions of the candidates matched against the peaks, under the
+// tolerance policy; ppm relative to the peak
+template <class Policy>
+class BasicSpectrumSearcher
 {
 public:
-    SpectrumSearcher(const double tol, const algorithm::search::ToleranceBy by, int isotope,
+    BasicSpectrumSearcher(const double tol, const algorithm::search::ToleranceBy by, int isotope,
         engine::glycan::NGlycanBuilder* builder, bool decoy_search):
             tolerance_(tol), by_(by), isotopic_(isotope), builder_(builder), decoy_search_(decoy_search),
-                searcher_(algorithm::search::BucketSearch<model::spectrum::Peak>(tol, by)),
-                binary_(algorithm::search::BinarySearch(tol, by)){}
+                table_(nullptr), bitmap_(algorithm::search::BasicBitmapSearch<Policy>(tol, by)){}
 
     void Init()
     {
@@ -44,60 +52,158 @@ public:
 
     model::spectrum::Spectrum& Spectrum() { return spectrum_; }
     MatchResultStore& Candidate() { return candidate_; }
-    void set_spectrum(const model::spectrum::Spectrum& spectrum) { spectrum_ = spectrum; }
+    void set_spectrum(const model::spectrum::Spectrum& spectrum) 
+        { spectrum_ = spectrum; preprocessed_ = nullptr; }
+    // a spectrum preprocessed ahead, searched without normalizing it again;
+    // the cache keeps the precursor as read, the one searched may be recalibrated
+    void set_spectrum(const engine::spectrum::PreprocessedSpectrum* spectrum, double precursor_mz)
+    {
+        spectrum_ = spectrum->Spectrum();
+        spectrum_.set_parent_mz(precursor_mz);
+        preprocessed_ = spectrum;
+    }
     void set_candidate(const MatchResultStore& candidate) { candidate_ = candidate; }
+    const FragmentTable* Table() const { return table_; }
+    void set_table(const FragmentTable* table) { table_ = table; }
+    // backbone index of each ion series, spectra of a series without one
+    // score their backbone ions from the table
+    const FragmentIndex* Index(IonSeries series = IonSeries::All) const 
+        { return index_[(int) series]; }
+    void set_index(const FragmentIndex* index) { index_[(int) index->Series()] = index; }
 
     double Tolerance() const { return tolerance_; }
     algorithm::search::ToleranceBy ToleranceType() const { return by_; }
     int Isoptoic() const { return isotopic_; }
     void set_tolerance(double tol) 
-        { tolerance_ = tol; searcher_.set_tolerance(tol); searcher_.Init(); }
+        { tolerance_ = tol; bitmap_.set_tolerance(tol); }
     void set_tolerance_by(algorithm::search::ToleranceBy by) 
-        { by_ = by; searcher_.set_tolerance_by(by); searcher_.Init(); }
+        { by_ = by; bitmap_.set_tolerance_by(by); }
     void set_isotopic(int isotope)
         { isotopic_ = isotope; }
+    // candidates checked against the score bound, and those skipped by it
+    long Bounded() const { return bounded_; }
+    long Pruned() const { return pruned_; }
+    // skip the isomers of compositions bounded below the best floor, on by default
+    bool Prune() const { return prune_; }
+    void set_prune(bool prune) { prune_ = prune; }
+    // candidates per spectrum scored down to the isomers, 0 for all
+    int TopK() const { return top_k_; }
+    void set_top_k(int k) { top_k_ = k; }
+    // skip peptides without the intact peptide (Y0) or peptide + HexNAc (Y1) ion
+    bool YGate() const { return y_gate_; }
+    void set_y_gate(bool gate) { y_gate_ = gate; }
+    long Gated() const { return gated_; }
+    // spectra come deisotoped, their fragments are matched under charge 1 only
+    bool Deisotoped() const { return deisotoped_; }
+    void set_deisotoped(bool deisotoped) { deisotoped_ = deisotoped; }
 
     std::vector<SearchResult> Search()
     {
         SearchInit();
+        std::vector<model::spectrum::Peak> oxonium = SearchOxonium();
+        return SearchCandidates(oxonium, oxonium.empty() ? 0 : PeakValue());
+    }
+
+    // targets and decoys of the spectrum in one pass, the peaks, oxonium ions
+    // and score base are prepared once and the decoy candidates scored as a
+    // decoy search
+    void JointSearch(MatchResultStore decoy_candidate,
+        std::vector<SearchResult>& targets, std::vector<SearchResult>& decoys)
+    {
+        SearchInit();
+        std::vector<model::spectrum::Peak> oxonium = SearchOxonium();
+        double peak_value = oxonium.empty() ? 0 : PeakValue();
+        bool decoy_search = decoy_search_;
+        decoy_search_ = false;
+        targets = SearchCandidates(oxonium, peak_value);
+
+        std::swap(candidate_, decoy_candidate);
+        decoy_search_ = true;
+        decoys = SearchCandidates(oxonium, peak_value);
+
+        std::swap(candidate_, decoy_candidate);
+        decoy_search_ = decoy_search;
+    }
+
+protected:
+    std::vector<SearchResult> SearchCandidates
+        (const std::vector<model::spectrum::Peak>& oxonium, double peak_value)
+    {
         ResultCollector collector;
 
-        collector.OxoniumCollect(SearchOxonium());
+        collector.OxoniumCollect(oxonium);
         if (collector.OxoniumMiss()) 
             return collector.Result();
 
-        collector.SpectrumBase(spectrum_.Peaks());
-        for(const auto& peptide : candidate_.Peptides())
+        collector.SpectrumBase(peak_value);
+        SearchBackbone();
+        std::vector<CandidateScore> candidates = Prefilter();
+        subset_match_.assign(candidate_.Peptides().size(), SubsetMatches());
+
+        // composition level first: the subset masses shared by all isomers give
+        // a score every isomer reaches, the masses of any isomer a score none
+        // exceeds; for targets only compositions whose bound reaches the best
+        // shared score get their isomers enumerated
+        double floor = 0;
+        if (!decoy_search_ && prune_)
         {
-            for(const auto& composite: candidate_.Glycans(peptide))
+            for(auto& candidate : candidates)
             {
+                SelectPeptide(candidate);
                 collector.InitCollect();
-                for (const auto& pos : engine::protein::ProteinPTM::FindNGlycanSite(peptide))
+                for (const auto& site : candidate.sites)
                 {
-                   collector.PeptideCollect(SearchPeptides(peptide, composite, pos), pos);
+                    collector.PeptideCollect(site.second, site.first);
                 }
-                if (collector.PeptideMiss()) continue;
-                        
+                const SubsetMasses& subset = Subsets(candidate.composite);
+                candidate.bound = GlycanBound(subset);
+                double glycan_floor = GlycanFloor(subset);
+                if (glycan_floor > 0)
+                    floor = std::max(floor, collector.TotalScore(glycan_floor));
+            }
+        }
+
+        for(const auto& candidate : candidates)
+        {
+            SelectPeptide(candidate);
+            const std::string& peptide = candidate.peptide;
+            const std::string& composite = candidate.composite;
+            collector.InitCollect();
+            for (const auto& site : candidate.sites)
+            {
+                collector.PeptideCollect(site.second, site.first);
+            }
 
-                std::unordered_map<std::string, double> result_core, result_branch, result_terminal;
-                for(const auto & isomer : glycan_isomer_.Query(composite))
+            // only the best is kept for targets, skip the isomers when
+            // even the bound of their scores cannot reach it
+            if (!decoy_search_ && prune_)
+            {
+                bounded_++;
+                if (collector.BoundMiss(candidate.bound, floor))
                 {
-                    collector.GlycanCollect(SearchGlycans(peptide, isomer, glycan_core_), 
-                        isomer, SearchType::Core);
-                    if (collector.GlycanMiss(isomer)) continue;
-
-                    collector.GlycanCollect(SearchGlycans(peptide, isomer, glycan_branch_), 
-                        isomer, SearchType::Branch);
-                    collector.GlycanCollect(SearchGlycans(peptide, isomer, glycan_terminal_), 
-                        isomer, SearchType::Terminal);
+                    pruned_++;
+                    continue;
                 }
-                if (collector.GlycanMiss()) continue;
-                          
-                if (decoy_search_)
-                    collector.Update(spectrum_.Scan(), peptide, composite);
-                else
-                    collector.BestUpdate(spectrum_.Scan(), peptide, composite);
             }
+
+            std::unordered_map<std::string, double> result_core, result_branch, result_terminal;
+            for(const auto & isomer : glycan_isomer_.Query(composite))
+            {
+                collector.GlycanCollect(SearchGlycans(isomer, glycan_core_), 
+                    isomer, SearchType::Core);
+                if (collector.GlycanMiss(isomer)) continue;
+
+                collector.GlycanCollect(SearchGlycans(isomer, glycan_branch_), 
+                    isomer, SearchType::Branch);
+                collector.GlycanCollect(SearchGlycans(isomer, glycan_terminal_), 
+                    isomer, SearchType::Terminal);
+            }
+            if (collector.GlycanMiss()) continue;
+                      
+            if (decoy_search_)
+                collector.Update(spectrum_.Scan(), peptide, composite);
+            else
+                collector.BestUpdate(spectrum_.Scan(), peptide, composite);
         }
         if (collector.Empty())
             return collector.Result();
@@ -113,170 +219,392 @@ public:
         return collector.BestResult();   
     }
 
-protected:
     void SearchInit()
     {
-        std::vector<std::shared_ptr<algorithm::search::Point<model::spectrum::Peak>>> mz_points;
-        for(const auto& it : spectrum_.Peaks())
+        // neutral masses under each charge, and the bitmap of the singly charged ones;
+        // a window of tol * charge at charge z is a window of tol at charge 1
+        if (preprocessed_ != nullptr)
+        {
+            neutral_ = &preprocessed_->Neutral();
+        }
+        else
         {
-            std::shared_ptr<algorithm::search::Point<model::spectrum::Peak>> p = 
-                std::make_shared<algorithm::search::Point<model::spectrum::Peak>>(it.MZ(), it);
-            mz_points.push_back(std::move(p));
+            int max_charge = spectrum_.PrecursorCharge();
+            neutral_mass_.Init(spectrum_.Peaks(), deisotoped_ ? std::min(max_charge, 1) : max_charge);
+            neutral_ = &neutral_mass_;
         }
-                    
-        searcher_.set_data(std::move(mz_points));
-        searcher_.Init();
+        bitmap_.Init(neutral_->Mass(1), neutral_->Size());
+        // only the ion series of the activation are matched
+        series_ = SeriesOf(spectrum_.Type());
+    }
+
+    // sum of squared intensities of the spectrum, the base of the scores
+    double PeakValue()
+    {
+        if (preprocessed_ != nullptr)
+            return preprocessed_->PeakValue();
+        return SearchResult::PeakValue(spectrum_.Peaks());
     }
 
     std::vector<model::spectrum::Peak> SearchOxonium()
     {
         std::vector<model::spectrum::Peak> res;
+        const std::vector<model::spectrum::Peak>& peaks = spectrum_.Peaks();
         for (const auto& mass : oxonium_)
         {
-            for(int charge = 1; charge <= spectrum_.PrecursorCharge(); charge++)
+            for(int charge = 1; charge <= neutral_->MaxCharge(); charge++)
             {
                 double mz = util::mass::SpectrumMass::ComputeMZ(mass, charge);
-                std::vector<model::spectrum::Peak> p = searcher_.Query(mz);
-                if (! p.empty())
+                double lower, upper;
+                Policy::Window(mz, tolerance_, -1, 1, by_, lower, upper);
+
+                int first, last, best = -1;
+                if (!bitmap_.Search(Lower(lower - util::mass::SpectrumMass::kIon), 
+                        Upper(upper - util::mass::SpectrumMass::kIon), first, last)) 
+                    continue;
+                marks_.assign(last - first, 0);
+                if (WindowMatch(neutral_->MZ() + first, last - first, 
+                        mz, 0, 1, marks_.data()) == 0)
+                    continue;
+                for(int i = first; i < last; i++)
+                {
+                    if (!marks_[i - first]) continue;
+                    const model::spectrum::Peak& peak = peaks[neutral_->Peak(i)];
+                    if (best < 0 || IntensityCmp(peaks[best], peak))
+                        best = neutral_->Peak(i);
+                }
+                if (best >= 0)
                 {
-                    res.push_back(*std::max_element(p.begin(), p.end(), IntensityCmp));
+                    res.push_back(peaks[best]);
                 }
             }
         }
         return res;
     }
 
-    std::vector<model::spectrum::Peak> SearchPeptides
-        (const std::string& seq, const std::string& composite, const int pos)
+    // a (peptide, composite) with the score of each site matched
+    struct CandidateScore
     {
-        std::vector<model::spectrum::Peak> res;
-        std::vector<double> peptides_mz;
-       
-        // speed up
-        std::string key = seq + std::to_string(pos);
-        if (peptides_ptm_mz_.find(key) == peptides_ptm_mz_.end())
+        std::string peptide;
+        int peptide_id;
+        double peptide_mass;
+        std::string composite;
+        std::vector<std::pair<int, double>> sites;
+        double score;
+        double bound;
+    };
+
+    // first stage: the backbone and glycan-attached ions of each site, plus the
+    // Y1 and Y2 ions of the peptide; with top_k_ set, only the top K candidates
+    // are kept, in their original order, for the isomer scoring. With y_gate_
+    // set, a peptide whose Y0 and Y1 ions are both missing expands no composite.
+    std::vector<CandidateScore> Prefilter()
+    {
+        std::vector<CandidateScore> res;
+        int peptide_id = -1;
+        for(const auto& peptide : candidate_.Peptides())
         {
-            peptides_ptm_mz_[key] = ComputePTMPeptideMass(seq, pos);
-            std::sort(peptides_ptm_mz_[key].begin(), peptides_ptm_mz_[key].end());
+            peptide_id++;
+            double peptide_mass = util::mass::PeptideMass::Compute(peptide);
+            if (y_gate_)
+            {
+                // unshifted, a shift would only match peaks above it and leave
+                // out a Y0 read light
+                const double y_ions[2] = 
+                    { peptide_mass, peptide_mass + util::mass::GlycanMass::kHexNAc };
+                if (BitmapScore(y_ions, y_ions + 2, 0) <= 0)
+                {
+                    gated_++;
+                    continue;
+                }
+            }
 
-            peptides_mz_[key] = ComputeNonePTMPeptideMass(seq, pos);
-            std::sort(peptides_mz_[key].begin(), peptides_mz_[key].end());
+            std::vector<int> sites = engine::protein::ProteinPTM::FindNGlycanSite(peptide);
+            double y_score = 0;
+            if (top_k_ > 0)
+            {
+                const double y_ions[2] = 
+                    { util::mass::GlycanMass::kHexNAc, util::mass::GlycanMass::kHexNAc * 2 };
+                y_score = BitmapScore(y_ions, y_ions + 2, peptide_mass);
+            }
+            for(const auto& composite: candidate_.Glycans(peptide))
+            {
+                CandidateScore candidate;
+                candidate.score = 0;
+                for (const auto& pos : sites)
+                {
+                    double score = SearchPeptides(peptide, composite, pos);
+                    if (score <= 0) continue;
+                    candidate.sites.push_back(std::make_pair(pos, score));
+                    candidate.score = std::max(candidate.score, score);
+                }
+                if (candidate.sites.empty()) continue;
+                candidate.peptide = peptide;
+                candidate.peptide_id = peptide_id;
+                candidate.peptide_mass = peptide_mass;
+                candidate.composite = composite;
+                candidate.bound = 0;
+                candidate.score += y_score;
+                res.push_back(std::move(candidate));
+            }
         }
+        if (top_k_ <= 0 || (int) res.size() <= top_k_)
+            return res;
 
-        // search ptm
-        binary_.set_data(peptides_ptm_mz_[key]);
-        double extra = util::mass::GlycanMass::Compute(model::glycan::Glycan::Interpret(composite));
-        for(const auto& pk : spectrum_.Peaks())
+        std::vector<int> order(res.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+            [&res](int i, int j) { return res[i].score > res[j].score; });
+        order.resize(top_k_);
+        std::sort(order.begin(), order.end());
+        std::vector<CandidateScore> top;
+        for(const auto& i : order)
         {
-            for (int charge = 1; charge <= spectrum_.PrecursorCharge(); charge++)
+            top.push_back(std::move(res[i]));
+        }
+        return top;
+    }
+
+    // backbone ions of every candidate (peptide, site), scored in one pass over the peaks
+    void SearchBackbone()
+    {
+        backbone_.clear();
+        const FragmentIndex* index = index_[(int) series_];
+        if (table_ == nullptr || index == nullptr) return;
+
+        slots_.clear();
+        for(const auto& peptide : candidate_.Peptides())
+        {
+            int id = table_->ID(peptide);
+            if (id < 0) continue;
+            for(int slot = table_->SlotBegin(id); slot < table_->SlotEnd(id); slot++)
             {
-                double target = util::mass::SpectrumMass::Compute(pk.MZ(), charge);
-                if (binary_.ToleranceType() == algorithm::search::ToleranceBy::PPM)
-                    binary_.set_base(target);
-                else if (binary_.ToleranceType() == algorithm::search::ToleranceBy::Dalton)
-                    binary_.set_scale(charge);
-                if (target > extra && binary_.Search(target-extra))
-                {
-                    res.push_back(pk);
-                    break;
-                }
+                slots_.push_back(slot);
             }
         }
+        index->Score<Policy>(*neutral_, spectrum_.Peaks(), slots_, workspace_, slot_score_);
+        for(int k = 0; k < (int) slots_.size(); k++)
+        {
+            backbone_[slots_[k]] = slot_score_[k];
+        }
+    }
+
+    double SearchPeptides
+        (const std::string& seq, const std::string& composite, const int pos)
+    {
+        // shared ions, computed once after digestion
+        const double *ptm_begin, *ptm_end, *begin, *end;
+        int id = (table_ == nullptr) ? -1 : table_->ID(seq);
+        int slot = (id < 0) ? -1 : table_->Slot(id, pos);
+        if (slot >= 0)
+        {
+            ptm_begin = table_->Begin(slot, FragmentType::PTM, series_);
+            ptm_end = table_->End(slot, FragmentType::PTM, series_);
+            begin = table_->Begin(slot, FragmentType::NonePTM, series_);
+            end = table_->End(slot, FragmentType::NonePTM, series_);
+        }
+        else
+        {
+            peptides_ptm_mz_ = FragmentTable::ComputePTMPeptideMass(seq, pos);
+            FragmentTable::Sort(peptides_ptm_mz_.data(), peptides_ptm_mz_.data() + peptides_ptm_mz_.size());
+            peptides_mz_ = FragmentTable::ComputeNonePTMPeptideMass(seq, pos);
+            FragmentTable::Sort(peptides_mz_.data(), peptides_mz_.data() + peptides_mz_.size());
+            SeriesRange(peptides_ptm_mz_, ptm_begin, ptm_end);
+            SeriesRange(peptides_mz_, begin, end);
+        }
+
+        // search ptm
+        double extra = util::mass::GlycanMass::Compute(model::glycan::Glycan::Interpret(composite));
+        double score = BitmapScore(ptm_begin, ptm_end, extra);
+
+        // search peptides, from the index when available
+        auto it = backbone_.find(slot);
+        if (it != backbone_.end())
+            return score + it->second;
+        return score + BitmapScore(begin, end, 0);
+    }
+
+    // ions of the spectrum's series among b, y, c, z ions of one peptide
+    void SeriesRange(const std::vector<double>& ions, const double*& begin, const double*& end) const
+    {
+        const double* middle = ions.data() + ions.size() / 2;
+        begin = series_ == IonSeries::CZ ? middle : ions.data();
+        end = series_ == IonSeries::BY ? middle : ions.data() + ions.size();
+    }
 
-        // search peptides
-        binary_.set_data(peptides_mz_[key]);
-        for(const auto& pk : spectrum_.Peaks())
+    // isomers share most of their subset masses, so each distinct mass is matched
+    // once per (spectrum, peptide) and the isomer score unions the stored peaks;
+    // the masses are shifted by the peptide of SelectPeptide
+    double SearchGlycans
+        (const std::string& id, const engine::glycan::GlycanMassStore& store)
+    {
+        marks_.assign(neutral_->Size(), 0);
+        for(const auto& mass : store.Query(id))
         {
-            for (int charge = 1; charge <= spectrum_.PrecursorCharge(); charge++)
+            for(const auto& i : SubsetMatch(mass, peptide_mass_))
             {
-                double target = util::mass::SpectrumMass::Compute(pk.MZ(), charge);
-                if (binary_.ToleranceType() == algorithm::search::ToleranceBy::PPM)
-                    binary_.set_base(target);
-                else if (binary_.ToleranceType() == algorithm::search::ToleranceBy::Dalton)
-                    binary_.set_scale(charge);
-                if (binary_.Search(target))
-                {
-                    res.push_back(pk);
-                    break;
-                }
+                marks_[i] = 1;
             }
         }
-        return res;
+        return util::calc::Simd::MaskedSquareSum(neutral_->Intensity(), marks_.data(), neutral_->Size());
     }
 
-    std::vector<model::spectrum::Peak> SearchGlycans
-        (const std::string& seq, const std::string& id, 
-        engine::glycan::GlycanMassStore& glycan_mass_)
+    // peaks (in sorted order) matched by the subset mass under any charge
+    const std::vector<int>& SubsetMatch(double mass, double shift)
     {
-        std::vector<model::spectrum::Peak> res;
-        std::unordered_set<double> subset = glycan_mass_.Query(id);
-        std::vector<double> subset_mass;
-        subset_mass.insert(subset_mass.end(), subset.begin(), subset.end());
-        binary_.set_data(subset_mass);
-        binary_.Init();
-
-        double extra = util::mass::PeptideMass::Compute(seq);
-        for(const auto& pk : spectrum_.Peaks())
+        SubsetMatches& matches = subset_match_[peptide_id_];
+        auto it = matches.find(mass);
+        if (it != matches.end())
+            return it->second;
+
+        std::vector<int>& peaks = matches[mass];
+        for(int charge = 1; charge <= neutral_->MaxCharge(); charge++)
         {
-            for(int charge = 1; charge <= spectrum_.PrecursorCharge(); charge++)
+            int first, last;
+            if (!IonRange(mass + shift, charge, first, last))
+                continue;
+            scratch_.assign(last - first, 0);
+            if (WindowMatch(neutral_->Mass(charge) + first, last - first, 
+                    mass, shift, charge, scratch_.data()) == 0)
+                continue;
+            for(int i = first; i < last; i++)
             {
-                double mass = util::mass::SpectrumMass::Compute(pk.MZ(), charge);
-                if (binary_.ToleranceType() == algorithm::search::ToleranceBy::PPM)
-                    binary_.set_base(mass);
-                else if (binary_.ToleranceType() == algorithm::search::ToleranceBy::Dalton)
-                    binary_.set_scale(charge);
-
-                if (mass > extra && binary_.Search(mass-extra))
-                {        
-                    res.push_back(pk);
-                    break;
-                }
+                if (scratch_[i - first])
+                    peaks.push_back(i);
             }
         }
-        return res;
+        return peaks;
     }
 
-    // for computing the peptide ions
-    static std::vector<double> ComputePTMPeptideMass(const std::string& seq, const int pos)
+    // squared intensity of the peaks whose mass under any charge, less the shift,
+    // matches an ion, each peak counted once; an (ion, charge) is a bit test on
+    // the bitmap, then a check of the few peaks it gathers
+    double BitmapScore(const double* begin, const double* end, double shift)
     {
-        std::vector<double> mass_list;
-        for (int i = pos; i < (int) seq.length() - 1; i++) // seldom at n
+        marks_.assign(neutral_->Size(), 0);
+        for(int charge = 1; charge <= neutral_->MaxCharge(); charge++)
         {
-            double mass = util::mass::IonMass::Compute(seq.substr(0, i+1), util::mass::IonType::b);
-            mass_list.push_back(mass);
-            mass = util::mass::IonMass::Compute(seq.substr(0, i+1), util::mass::IonType::c);
-            mass_list.push_back(mass);
+            const double* mass = neutral_->Mass(charge);
+            for(const double* it = begin; it != end; it++)
+            {
+                int first, last;
+                if (!IonRange(*it + shift, charge, first, last))
+                    continue;
+                WindowMatch(mass + first, last - first, 
+                    *it, shift, charge, marks_.data() + first);
+            }
         }
-        for (int i = 1; i <= pos; i++)
+        return util::calc::Simd::MaskedSquareSum(neutral_->Intensity(), marks_.data(), neutral_->Size());
+    }
+
+    // subset masses of a composite for core, branch and terminal: those of
+    // any isomer, and those shared by all of its isomers
+    struct SubsetMasses
+    {
+        std::vector<double> all[3];
+        std::vector<double> shared[3];
+    };
+
+    const SubsetMasses& Subsets(const std::string& composite)
+    {
+        auto it = subset_masses_.find(composite);
+        if (it != subset_masses_.end())
+            return it->second;
+
+        SubsetMasses& subset = subset_masses_[composite];
+        const engine::glycan::GlycanMassStore* stores[3] = 
+            { &glycan_core_, &glycan_branch_, &glycan_terminal_ };
+        std::unordered_set<std::string> isomers = glycan_isomer_.Query(composite);
+        for(int k = 0; k < 3; k++)
         {
-            double mass = util::mass::IonMass::Compute(seq.substr(i, seq.length()-i), util::mass::IonType::y);
-            mass_list.push_back(mass);
-            mass = util::mass::IonMass::Compute(seq.substr(i, seq.length()-i), util::mass::IonType::z);
-            mass_list.push_back(mass);
+            std::unordered_map<double, int> count;
+            for(const auto& isomer : isomers)
+            {
+                for(const auto& mass : stores[k]->Query(isomer))
+                {
+                    count[mass]++;
+                }
+            }
+            for(const auto& c : count)
+            {
+                subset.all[k].push_back(c.first);
+                if (c.second == (int) isomers.size())
+                    subset.shared[k].push_back(c.first);
+            }
         }
-        return mass_list;
+        return subset;
     }
 
-    static std::vector<double> ComputeNonePTMPeptideMass(const std::string& seq, const int pos)
+    // squared intensity of the peaks matched by any of the subset masses
+    double SubsetScore(const std::vector<double>& masses)
     {
-        std::vector<double> mass_list;
-        for (int i = 0; i < pos; i++) // seldom at n
+        if (masses.empty()) return 0;
+        marks_.assign(neutral_->Size(), 0);
+        for(const auto& mass : masses)
         {
-            double mass = util::mass::IonMass::Compute(seq.substr(0, i+1), util::mass::IonType::b);
-            mass_list.push_back(mass);
-            mass = util::mass::IonMass::Compute(seq.substr(0, i+1), util::mass::IonType::c);
-            mass_list.push_back(mass);
+            for(const auto& i : SubsetMatch(mass, peptide_mass_))
+            {
+                marks_[i] = 1;
+            }
         }
-        for (int i = pos + 1; i < (int) seq.length(); i++)
+        return util::calc::Simd::MaskedSquareSum(neutral_->Intensity(), marks_.data(), neutral_->Size());
+    }
+
+    // upper bound of core + branch + terminal of the best isomer: the peaks
+    // matched by the subset masses of any isomer; branch scores also fill
+    // the terminal when it has none
+    double GlycanBound(const SubsetMasses& subset)
+    {
+        double branch = SubsetScore(subset.all[1]);
+        return SubsetScore(subset.all[0]) + branch + std::max(branch, SubsetScore(subset.all[2]));
+    }
+
+    // score every isomer reaches from the shared masses, 0 unless the shared
+    // core matches (an isomer without a core match is not scored)
+    double GlycanFloor(const SubsetMasses& subset)
+    {
+        double core = SubsetScore(subset.shared[0]);
+        if (core <= 0) return 0;
+        return core + SubsetScore(subset.shared[1]) + SubsetScore(subset.shared[2]);
+    }
+
+    // peptide of the candidate, whose mass shifts the subset masses
+    void SelectPeptide(const CandidateScore& candidate)
+    {
+        peptide_id_ = candidate.peptide_id;
+        peptide_mass_ = candidate.peptide_mass;
+    }
+
+    // peaks whose charge-1 mass may match the target under the charge
+    bool IonRange(double target, int charge, int& first, int& last)
+    {
+        double lower, upper;
+        Policy::Window(target, tolerance_, -1, charge, by_, lower, upper);
+        return bitmap_.Search(Lower(lower / charge), Upper(upper / charge), first, last);
+    }
+
+    // marks the peaks of a bitmap window matching the ion, as Simd::ToleranceMatch
+    // does; a window holds a peak or two, too few for the vector kernels to pay
+    // for their dispatch (see util/calc/simd_bench.cpp)
+    int WindowMatch(const double* mass, int n, double ion, double shift,
+        double scale, char* marks) const
+    {
+        int count = 0;
+        for(int i = 0; i < n; i++)
         {
-            double mass = util::mass::IonMass::Compute(seq.substr(i, seq.length()-i), util::mass::IonType::y);
-            mass_list.push_back(mass);
-            mass = util::mass::IonMass::Compute(seq.substr(i, seq.length()-i), util::mass::IonType::z);
-            mass_list.push_back(mass);
+            if (mass[i] <= shift) continue;
+            if (Policy::Match(mass[i], ion + shift, tolerance_, -1, scale, by_))
+            {
+                marks[i] = 1;
+                count++;
+            }
         }
-        return mass_list;
+        return count;
     }
 
+    // windows are widened a little, the bitmap only preselects peaks
+    static double Lower(double mass) { return mass - std::abs(mass) * 1e-12; }
+    static double Upper(double mass) { return mass + std::abs(mass) * 1e-12; }
 
     static bool IntensityCmp(const model::spectrum::Peak& p1, const model::spectrum::Peak& p2)
         { return (p1.Intensity() < p2.Intensity()); }
@@ -286,25 +614,43 @@ protected:
     int isotopic_; // up to isotopic
     engine::glycan::NGlycanBuilder* builder_;
     bool decoy_search_;
-    algorithm::search::BucketSearch<model::spectrum::Peak> searcher_;
-    algorithm::search::BinarySearch binary_;
+    const FragmentTable* table_;
+    const FragmentIndex* index_[3] = {nullptr, nullptr, nullptr};
+    IonSeries series_ = IonSeries::All;
+    algorithm::search::BasicBitmapSearch<Policy> bitmap_;
+    const engine::spectrum::PreprocessedSpectrum* preprocessed_ = nullptr;
+    engine::spectrum::NeutralMass neutral_mass_;
+    const engine::spectrum::NeutralMass* neutral_ = &neutral_mass_;
     MatchResultStore candidate_;
     model::spectrum::Spectrum spectrum_;
-    std::unordered_map<std::string, std::vector<double>> peptides_ptm_mz_;
-    std::unordered_map<std::string, std::vector<double>> peptides_mz_; 
+    std::vector<double> peptides_ptm_mz_, peptides_mz_;
+    std::vector<char> marks_, scratch_;
+    // peaks matched by each subset mass, per candidate peptide of the spectrum
+    typedef std::unordered_map<double, std::vector<int>> SubsetMatches;
+    int peptide_id_;
+    double peptide_mass_;
+    std::vector<SubsetMatches> subset_match_;
+    std::unordered_map<std::string, SubsetMasses> subset_masses_;
+    long bounded_ = 0;
+    long pruned_ = 0;
+    bool prune_ = true;
+    int top_k_ = 0;
+    bool y_gate_ = false;
+    bool deisotoped_ = false;
+    long gated_ = 0;
+    std::vector<int> slots_;
+    std::vector<double> slot_score_;
+    std::unordered_map<int, double> backbone_;
+    FragmentIndex::Workspace workspace_;
 
     engine::glycan::GlycanStore glycan_isomer_;
     engine::glycan::GlycanMassStore glycan_core_, glycan_branch_, glycan_terminal_;
 
-    const std::vector<double> oxonium_ 
-    {
-        util::mass::GlycanMass::kHexNAc,
-        util::mass::GlycanMass::kHexNAc - util::mass::GlycanMass::kWater,
-        util::mass::GlycanMass::kHexNAc - util::mass::GlycanMass::kWater * 2,
-        util::mass::GlycanMass::kHexNAc + util::mass::GlycanMass::kHex
-    };
+    const std::vector<double>& oxonium_ = engine::spectrum::OxoniumFilter::Ions();
 }; 
 
+typedef BasicSpectrumSearcher<algorithm::search::DynamicTolerance> SpectrumSearcher;
+
 } // namespace engine
 } // namespace search
 
@@ -0,0 +1,123 @@
+#ifndef ENGINE_SPECTRUM_DEISOTOPE_H
+#define ENGINE_SPECTRUM_DEISOTOPE_H
+
+#include <vector>
+#include <algorithm>
+#include "../../model/spectrum/spectrum.h"
+#include "../../algorithm/search/tolerance.h"
+#include "../../util/mass/spectrum.h"
+
+namespace engine {
+namespace spectrum {
+
+// collapses each isotope envelope to its monoisotopic peak, moved to the
+// singly charged mz and carrying the summed intensity of the envelope.
+// Peaks outside any envelope are kept as singly charged, so fragments of a
+// transformed spectrum are matched under charge 1 only.
+class Deisotoper
+{
+public:
+    Deisotoper(double tol, algorithm::search::ToleranceBy by):
+        tolerance_(tol), by_(by){}
+
+    double Tolerance() const { return tolerance_; }
+    algorithm::search::ToleranceBy ToleranceType() const { return by_; }
+    void set_tolerance(double tol) { tolerance_ = tol; }
+    void set_tolerance_by(algorithm::search::ToleranceBy by) { by_ = by; }
+
+    // charge of each peak of the last spectrum transformed
+    const std::vector<int>& Charges() const { return charges_; }
+
+    // envelopes of charge up to the precursor charge
+    void Transform(model::spectrum::Spectrum& spec)
+    {
+        Transform(spec.Peaks(), (int) spec.PrecursorCharge());
+    }
+
+    void Transform(std::vector<model::spectrum::Peak>& peaks, int max_charge)
+    {
+        std::stable_sort(peaks.begin(), peaks.end());
+        int size = peaks.size();
+        used_.assign(size, 0);
+
+        std::vector<std::pair<model::spectrum::Peak, int>> res;
+        for(int i = 0; i < size; i++)
+        {
+            if (used_[i]) continue;
+
+            // the charge explaining the longest envelope, the lower one on ties
+            int best_charge = 1;
+            chain_.clear();
+            for(int charge = 1; charge <= max_charge; charge++)
+            {
+                Envelope(peaks, i, charge, envelope_);
+                if (envelope_.size() > std::max(chain_.size(), (size_t) 1))
+                {
+                    best_charge = charge;
+                    std::swap(chain_, envelope_);
+                }
+            }
+
+            double intensity = peaks[i].Intensity();
+            for(const auto& j : chain_)
+            {
+                used_[j] = 1;
+                if (j != i)
+                    intensity += peaks[j].Intensity();
+            }
+            double mass = util::mass::SpectrumMass::Compute(peaks[i].MZ(), best_charge);
+            res.push_back(std::make_pair(model::spectrum::Peak(
+                util::mass::SpectrumMass::ComputeMZ(mass, 1), intensity), best_charge));
+        }
+
+        std::stable_sort(res.begin(), res.end(),
+            [](const std::pair<model::spectrum::Peak, int>& a,
+                const std::pair<model::spectrum::Peak, int>& b) { return a.first < b.first; });
+        peaks.clear();
+        charges_.clear();
+        for(const auto& it : res)
+        {
+            peaks.push_back(it.first);
+            charges_.push_back(it.second);
+        }
+    }
+
+    static constexpr double kIsotope = util::mass::SpectrumMass::kIsotope;
+
+protected:
+    // unused peaks spaced one isotope apart under the charge, from peak i on
+    void Envelope(const std::vector<model::spectrum::Peak>& peaks, int i, int charge,
+        std::vector<int>& envelope) const
+    {
+        envelope.assign(1, i);
+        int size = peaks.size();
+        int j = i + 1;
+        while (j < size)
+        {
+            double expect = peaks[envelope.back()].MZ() + kIsotope / charge;
+            double tol = by_ == algorithm::search::ToleranceBy::PPM ?
+                expect * tolerance_ / 1000000.0 : tolerance_;
+            while (j < size && peaks[j].MZ() < expect - tol) j++;
+            int next = -1;
+            for(; j < size && peaks[j].MZ() <= expect + tol; j++)
+            {
+                if (!used_[j] && (next < 0 || peaks[j].Intensity() > peaks[next].Intensity()))
+                    next = j;
+            }
+            if (next < 0) break;
+            envelope.push_back(next);
+            j = next + 1;
+        }
+    }
+
+    double tolerance_;
+    algorithm::search::ToleranceBy by_;
+    std::vector<int> charges_;
+    std::vector<char> used_;
+    std::vector<int> chain_, envelope_;
+};
+
+} // namespace spectrum
+} // namespace engine
+
+#endif
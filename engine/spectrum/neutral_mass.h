@@ -0,0 +1,98 @@
+#ifndef ENGINE_SPECTRUM_NEUTRAL_MASS_H
+#define ENGINE_SPECTRUM_NEUTRAL_MASS_H
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include "../../model/spectrum/spectrum.h"
+#include "../../util/mass/spectrum.h"
+#include "../../util/io/binary_io.h"
+
+namespace engine {
+namespace spectrum {
+
+// neutral masses of the peaks under each charge, sorted ascending,
+// computed once per spectrum and shared by all candidates
+class NeutralMass
+{
+public:
+    NeutralMass() = default;
+
+    void Init(const std::vector<model::spectrum::Peak>& peaks, int max_charge)
+    {
+        size_ = peaks.size();
+        max_charge_ = max_charge;
+
+        // rank of peaks by mz, mass is monotonic in mz under any charge
+        order_.resize(size_);
+        std::iota(order_.begin(), order_.end(), 0);
+        if (!std::is_sorted(peaks.begin(), peaks.end()))
+        {
+            std::stable_sort(order_.begin(), order_.end(),
+                [&peaks](int i, int j) { return peaks[i].MZ() < peaks[j].MZ(); });
+        }
+
+        // mz and intensity in the same order, for the vector kernels
+        mz_.resize(size_);
+        intensity_.resize(size_);
+        for(int i = 0; i < size_; i++)
+        {
+            mz_[i] = peaks[order_[i]].MZ();
+            intensity_[i] = peaks[order_[i]].Intensity();
+        }
+
+        // charge 1 always, it keys the per-spectrum peak bitmap
+        mass_.resize(size_ * std::max(max_charge_, 1));
+        for(int charge = 1; charge <= std::max(max_charge_, 1); charge++)
+        {
+            double* mass = mass_.data() + (charge - 1) * size_;
+            for(int i = 0; i < size_; i++)
+            {
+                mass[i] = util::mass::SpectrumMass::Compute(peaks[order_[i]].MZ(), charge);
+            }
+        }
+    }
+
+    int Size() const { return size_; }
+    int MaxCharge() const { return max_charge_; }
+    // ascending masses of all peaks under the charge, 1 <= charge <= max(MaxCharge(), 1)
+    const double* Mass(int charge) const
+        { return mass_.data() + (charge - 1) * size_; }
+    // index into the spectrum peaks of the i-th mass
+    int Peak(int i) const { return order_[i]; }
+    const double* MZ() const { return mz_.data(); }
+    const double* Intensity() const { return intensity_.data(); }
+
+    void Save(std::ostream& out) const
+    {
+        util::io::BinaryIO::Write(out, size_);
+        util::io::BinaryIO::Write(out, max_charge_);
+        util::io::BinaryIO::WriteVector(out, order_);
+        util::io::BinaryIO::WriteVector(out, mass_);
+        util::io::BinaryIO::WriteVector(out, mz_);
+        util::io::BinaryIO::WriteVector(out, intensity_);
+    }
+
+    bool Load(std::istream& in)
+    {
+        return util::io::BinaryIO::Read(in, size_) &&
+            util::io::BinaryIO::Read(in, max_charge_) &&
+            util::io::BinaryIO::ReadVector(in, order_) &&
+            util::io::BinaryIO::ReadVector(in, mass_) &&
+            util::io::BinaryIO::ReadVector(in, mz_) &&
+            util::io::BinaryIO::ReadVector(in, intensity_);
+    }
+
+protected:
+    int size_ = 0;
+    int max_charge_ = 0;
+    std::vector<int> order_;
+    std::vector<double> mass_;
+    std::vector<double> mz_;
+    std::vector<double> intensity_;
+};
+
+} // namespace spectrum
+} // namespace engine
+
+#endif
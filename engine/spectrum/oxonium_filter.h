@@ -0,0 +1,94 @@
+#ifndef ENGINE_SPECTRUM_OXONIUM_FILTER_H
+#define ENGINE_SPECTRUM_OXONIUM_FILTER_H
+
+#include <vector>
+#include "../../model/spectrum/spectrum.h"
+#include "../../algorithm/search/tolerance.h"
+#include "../../util/mass/glycan.h"
+#include "../../util/mass/spectrum.h"
+#include "../../util/calc/simd.h"
+
+namespace engine {
+namespace spectrum {
+
+// triage of glyco spectra: a spectrum is kept if any peak with intensity
+// matches an oxonium ion under a charge up to the precursor charge, the same
+// test the spectrum search makes before scoring
+class OxoniumFilter
+{
+public:
+    OxoniumFilter(double tol, algorithm::search::ToleranceBy by):
+        tolerance_(tol), by_(by){}
+
+    double Tolerance() const { return tolerance_; }
+    algorithm::search::ToleranceBy ToleranceType() const { return by_; }
+    void set_tolerance(double tol) { tolerance_ = tol; }
+    void set_tolerance_by(algorithm::search::ToleranceBy by) { by_ = by; }
+
+    static const std::vector<double>& Ions()
+    {
+        static const std::vector<double> ions
+        {
+            util::mass::GlycanMass::kHexNAc,
+            util::mass::GlycanMass::kHexNAc - util::mass::GlycanMass::kWater,
+            util::mass::GlycanMass::kHexNAc - util::mass::GlycanMass::kWater * 2,
+            util::mass::GlycanMass::kHexNAc + util::mass::GlycanMass::kHex
+        };
+        return ions;
+    }
+
+    bool Contains(model::spectrum::Spectrum& spectrum)
+    {
+        const std::vector<model::spectrum::Peak>& peaks = spectrum.Peaks();
+        int size = peaks.size();
+        mz_.resize(size);
+        intensity_.resize(size);
+        for(int i = 0; i < size; i++)
+        {
+            mz_[i] = peaks[i].MZ();
+            intensity_[i] = peaks[i].Intensity();
+        }
+
+        bool ppm = by_ == algorithm::search::ToleranceBy::PPM;
+        marks_.assign(size, 0);
+        int count = 0;
+        for(const auto& mass : Ions())
+        {
+            for(int charge = 1; charge <= spectrum.PrecursorCharge(); charge++)
+            {
+                double mz = util::mass::SpectrumMass::ComputeMZ(mass, charge);
+                count += util::calc::Simd::ToleranceMatch(mz_.data(), size,
+                    mz, 0, tolerance_, 1, ppm, marks_.data());
+            }
+        }
+        return count > 0 &&
+            util::calc::Simd::MaskedSquareSum(intensity_.data(), marks_.data(), size) > 0;
+    }
+
+    // keep the glyco spectra in their order, returns the number dropped
+    int Filter(std::vector<model::spectrum::Spectrum>& spectra)
+    {
+        int kept = 0;
+        for(int i = 0; i < (int) spectra.size(); i++)
+        {
+            if (!Contains(spectra[i])) continue;
+            if (kept != i)
+                spectra[kept] = std::move(spectra[i]);
+            kept++;
+        }
+        int dropped = spectra.size() - kept;
+        spectra.resize(kept);
+        return dropped;
+    }
+
+protected:
+    double tolerance_;
+    algorithm::search::ToleranceBy by_;
+    std::vector<double> mz_, intensity_;
+    std::vector<char> marks_;
+};
+
+} // namespace spectrum
+} // namespace engine
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef ENGINE_SPECTRUM_SPECTRUM_CACHE_H
+#define ENGINE_SPECTRUM_SPECTRUM_CACHE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <sys/stat.h>
+#include "../../model/spectrum/spectrum.h"
+#include "../../algorithm/search/tolerance.h"
+#include "../../util/io/binary_io.h"
+#include "normalize.h"
+#include "deisotope.h"
+#include "neutral_mass.h"
+
+namespace engine {
+namespace spectrum {
+
+// a spectrum as the search sees it: deisotoped when asked and normalized,
+// with the neutral masses of its peaks and their sum of squared intensities
+class PreprocessedSpectrum
+{
+public:
+    PreprocessedSpectrum() = default;
+
+    void Init(const model::spectrum::Spectrum& spectrum, Deisotoper* deisotoper)
+    {
+        spectrum_ = spectrum;
+        scan_ = spectrum_.Scan();
+        if (deisotoper != nullptr)
+            deisotoper->Transform(spectrum_);
+        Normalizer::Transform(spectrum_);
+        int max_charge = spectrum_.PrecursorCharge();
+        neutral_.Init(spectrum_.Peaks(), deisotoper != nullptr ? std::min(max_charge, 1) : max_charge);
+        peak_value_ = 0;
+        for(const auto& it : spectrum_.Peaks())
+        {
+            peak_value_ += it.Intensity() * it.Intensity();
+        }
+    }
+
+    int Scan() const { return scan_; }
+    const model::spectrum::Spectrum& Spectrum() const { return spectrum_; }
+    const NeutralMass& Neutral() const { return neutral_; }
+    double PeakValue() const { return peak_value_; }
+
+    void Save(std::ostream& out)
+    {
+        util::io::BinaryIO::Write(out, scan_);
+        util::io::BinaryIO::Write(out, spectrum_.Type());
+        util::io::BinaryIO::Write(out, spectrum_.PrecursorMZ());
+        util::io::BinaryIO::Write(out, (int) spectrum_.PrecursorCharge());
+        std::vector<double> mz, intensity;
+        for(const auto& it : spectrum_.Peaks())
+        {
+            mz.push_back(it.MZ());
+            intensity.push_back(it.Intensity());
+        }
+        util::io::BinaryIO::WriteVector(out, mz);
+        util::io::BinaryIO::WriteVector(out, intensity);
+        util::io::BinaryIO::Write(out, peak_value_);
+        neutral_.Save(out);
+    }
+
+    bool Load(std::istream& in)
+    {
+        int scan, charge;
+        model::spectrum::SpectrumType type;
+        double precursor_mz;
+        std::vector<double> mz, intensity;
+        if (!util::io::BinaryIO::Read(in, scan) || !util::io::BinaryIO::Read(in, type) ||
+            !util::io::BinaryIO::Read(in, precursor_mz) || !util::io::BinaryIO::Read(in, charge) ||
+            !util::io::BinaryIO::ReadVector(in, mz) || !util::io::BinaryIO::ReadVector(in, intensity) ||
+            mz.size() != intensity.size() || !util::io::BinaryIO::Read(in, peak_value_))
+            return false;
+
+        std::vector<model::spectrum::Peak> peaks;
+        for(int i = 0; i < (int) mz.size(); i++)
+        {
+            peaks.push_back(model::spectrum::Peak(mz[i], intensity[i]));
+        }
+        spectrum_ = model::spectrum::Spectrum();
+        spectrum_.set_peaks(peaks);
+        spectrum_.set_scan(scan);
+        scan_ = scan;
+        spectrum_.set_type(type);
+        spectrum_.set_parent_mz(precursor_mz);
+        spectrum_.set_parent_charge(charge);
+        return neutral_.Load(in);
+    }
+
+protected:
+    int scan_ = -1;
+    model::spectrum::Spectrum spectrum_;
+    NeutralMass neutral_;
+    double peak_value_ = 0;
+};
+
+// preprocessed spectra by scan, built once and shared by the target, decoy
+// and training passes; saved next to the spectrum file, a cache is only
+// loaded back under the same ms2 tolerance and deisotoping, and while that
+// file keeps the size and modification time it had when the cache was saved
+class SpectrumCache
+{
+public:
+    SpectrumCache(double tol, algorithm::search::ToleranceBy by, bool deisotope):
+        tolerance_(tol), by_(by), deisotope_(deisotope){}
+
+    double Tolerance() const { return tolerance_; }
+    algorithm::search::ToleranceBy ToleranceType() const { return by_; }
+    bool Deisotope() const { return deisotope_; }
+    bool Fits(double tol, algorithm::search::ToleranceBy by, bool deisotope) const
+        { return tolerance_ == tol && by_ == by && deisotope_ == deisotope; }
+
+    int Size() const { return spectra_.size(); }
+    bool Empty() const { return spectra_.empty(); }
+    const PreprocessedSpectrum* Find(int scan) const
+    {
+        auto it = index_.find(scan);
+        if (it == index_.end())
+            return nullptr;
+        return &spectra_[it->second];
+    }
+
+    void Init(const std::vector<model::spectrum::Spectrum>& spectra, int n_thread)
+    {
+        spectra_.assign(spectra.size(), PreprocessedSpectrum());
+
+        // each thread fills a disjoint range of spectra
+        n_thread = std::max(1, n_thread);
+        std::vector<std::thread> thread_pool;
+        for(int i = 0; i < n_thread; i++)
+        {
+            std::thread worker(&SpectrumCache::Fill, this, std::cref(spectra), i, n_thread);
+            thread_pool.push_back(std::move(worker));
+        }
+        for(auto& worker : thread_pool)
+        {
+            worker.join();
+        }
+        Index();
+    }
+
+    // the cache of a spectrum file
+    static std::string PathOf(const std::string& spectra_path)
+        { return spectra_path + ".cache"; }
+
+    // the spectra were read from source
+    bool Save(const std::string& path, const std::string& source)
+    {
+        long size, mtime;
+        if (!Stamp(source, size, mtime)) return false;
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) return false;
+        int version = kVersion;
+        util::io::BinaryIO::Write(out, version);
+        util::io::BinaryIO::Write(out, size);
+        util::io::BinaryIO::Write(out, mtime);
+        util::io::BinaryIO::Write(out, tolerance_);
+        util::io::BinaryIO::Write(out, by_);
+        util::io::BinaryIO::Write(out, deisotope_);
+        util::io::BinaryIO::Write(out, (long) spectra_.size());
+        for(auto& it : spectra_)
+        {
+            it.Save(out);
+        }
+        return (bool) out;
+    }
+
+    // false, leaving the cache empty, for a missing, unfit or corrupt file,
+    // or one saved from another version of source
+    bool Load(const std::string& path, const std::string& source)
+    {
+        spectra_.clear();
+        index_.clear();
+        long source_size, source_mtime;
+        if (!Stamp(source, source_size, source_mtime)) return false;
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) return false;
+
+        int version;
+        long size, mtime;
+        double tol;
+        algorithm::search::ToleranceBy by;
+        bool deisotope;
+        long count;
+        if (!util::io::BinaryIO::Read(in, version) || version != kVersion ||
+            !util::io::BinaryIO::Read(in, size) || !util::io::BinaryIO::Read(in, mtime) ||
+            size != source_size || mtime != source_mtime ||
+            !util::io::BinaryIO::Read(in, tol) || !util::io::BinaryIO::Read(in, by) ||
+            !util::io::BinaryIO::Read(in, deisotope) || !Fits(tol, by, deisotope) ||
+            !util::io::BinaryIO::Read(in, count) || count < 0 || 
+            count > util::io::BinaryIO::Remaining(in))
+            return false;
+
+        spectra_.resize(count);
+        for(auto& it : spectra_)
+        {
+            if (!it.Load(in))
+            {
+                spectra_.clear();
+                return false;
+            }
+        }
+        Index();
+        return true;
+    }
+
+    // size and modification time (in ns) of a file
+    static bool Stamp(const std::string& path, long& size, long& mtime)
+    {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) return false;
+        size = info.st_size;
+        mtime = (long) info.st_mtim.tv_sec * 1000000000L + info.st_mtim.tv_nsec;
+        return true;
+    }
+
+    static constexpr int kVersion = 2;
+
+protected:
+    void Fill(const std::vector<model::spectrum::Spectrum>& spectra, int start, int step)
+    {
+        Deisotoper deisotoper(tolerance_, by_);
+        for(int i = start; i < (int) spectra.size(); i += step)
+        {
+            spectra_[i].Init(spectra[i], deisotope_ ? &deisotoper : nullptr);
+        }
+    }
+
+    void Index()
+    {
+        index_.clear();
+        for(int i = 0; i < (int) spectra_.size(); i++)
+        {
+            index_[spectra_[i].Scan()] = i;
+        }
+    }
+
+    double tolerance_;
+    algorithm::search::ToleranceBy by_;
+    bool deisotope_;
+    std::vector<PreprocessedSpectrum> spectra_;
+    std::unordered_map<int, int> index_; // scan -> spectrum
+};
+
+} // namespace spectrum
+} // namespace engine
+
+#endif
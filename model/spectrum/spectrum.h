@@ -7,8 +7,10 @@
 namespace model {
 namespace spectrum {
 
+// activation of an ms2 scan picks the ion series it can contain:
+// b/y under HCD (or CID), c/z under ETD, all four under EThcD
 enum class SpectrumType
-{ MS, EThcD, NONE };
+{ MS, EThcD, NONE, HCD, ETD };
 
 class Spectrum
 {
@@ -0,0 +1,224 @@
+#include "simd.h"
+
+#include <cmath>
+#include <immintrin.h>
+
+namespace util {
+namespace calc {
+
+namespace {
+
+typedef int (*ToleranceMatchKernel)(const double*, int, double, double,
+    double, double, bool, char*);
+typedef double (*MaskedSquareSumKernel)(const double*, const char*, int);
+
+// scalar
+
+inline bool ScalarMatch(double mass, double ion, double shift, double tol, double scale, bool ppm)
+{
+    if (mass <= shift) return false;
+    double diff = std::abs(ion - (mass - shift));
+    if (ppm) return diff / mass * 1000000.0 < tol;
+    return diff < tol * scale;
+}
+
+int ScalarToleranceMatch(const double* mass, int n, double ion, double shift,
+    double tol, double scale, bool ppm, char* marks)
+{
+    int count = 0;
+    for(int i = 0; i < n; i++)
+    {
+        if (ScalarMatch(mass[i], ion, shift, tol, scale, ppm))
+        {
+            marks[i] = 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+double ScalarMaskedSquareSum(const double* intensity, const char* marks, int n)
+{
+    double sum = 0;
+    for(int i = 0; i < n; i++)
+    {
+        if (marks[i])
+            sum += intensity[i] * intensity[i];
+    }
+    return sum;
+}
+
+// avx2, 4 doubles per step
+
+__attribute__((target("avx2")))
+int AVX2ToleranceMatch(const double* mass, int n, double ion, double shift,
+    double tol, double scale, bool ppm, char* marks)
+{
+    const __m256d v_ion = _mm256_set1_pd(ion);
+    const __m256d v_shift = _mm256_set1_pd(shift);
+    const __m256d v_limit = _mm256_set1_pd(ppm ? tol : tol * scale);
+    const __m256d v_ppm = _mm256_set1_pd(1000000.0);
+    const __m256d v_sign = _mm256_set1_pd(-0.0);
+
+    int count = 0, i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        __m256d m = _mm256_loadu_pd(mass + i);
+        __m256d diff = _mm256_andnot_pd(v_sign, _mm256_sub_pd(v_ion, _mm256_sub_pd(m, v_shift)));
+        if (ppm)
+            diff = _mm256_mul_pd(_mm256_div_pd(diff, m), v_ppm);
+        __m256d ok = _mm256_and_pd(_mm256_cmp_pd(diff, v_limit, _CMP_LT_OQ),
+            _mm256_cmp_pd(m, v_shift, _CMP_GT_OQ));
+        int bits = _mm256_movemask_pd(ok);
+        while (bits)
+        {
+            marks[i + __builtin_ctz(bits)] = 1;
+            bits &= bits - 1;
+            count++;
+        }
+    }
+    return count + ScalarToleranceMatch(mass + i, n - i, ion, shift, tol, scale, ppm, marks + i);
+}
+
+__attribute__((target("avx2")))
+double AVX2MaskedSquareSum(const double* intensity, const char* marks, int n)
+{
+    __m256d v_sum = _mm256_setzero_pd();
+    int i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        int word;
+        __builtin_memcpy(&word, marks + i, 4);
+        __m256i flags = _mm256_cvtepi8_epi64(_mm_cvtsi32_si128(word));
+        __m256d mask = _mm256_castsi256_pd(
+            _mm256_xor_si256(_mm256_cmpeq_epi64(flags, _mm256_setzero_si256()), _mm256_set1_epi64x(-1)));
+        __m256d v = _mm256_loadu_pd(intensity + i);
+        v_sum = _mm256_add_pd(v_sum, _mm256_and_pd(mask, _mm256_mul_pd(v, v)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, v_sum);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3])
+        + ScalarMaskedSquareSum(intensity + i, marks + i, n - i);
+}
+
+// avx-512, 8 doubles per step
+
+__attribute__((target("avx512f")))
+int AVX512ToleranceMatch(const double* mass, int n, double ion, double shift,
+    double tol, double scale, bool ppm, char* marks)
+{
+    const __m512d v_ion = _mm512_set1_pd(ion);
+    const __m512d v_shift = _mm512_set1_pd(shift);
+    const __m512d v_limit = _mm512_set1_pd(ppm ? tol : tol * scale);
+    const __m512d v_ppm = _mm512_set1_pd(1000000.0);
+
+    int count = 0, i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        __m512d m = _mm512_loadu_pd(mass + i);
+        __m512d diff = _mm512_abs_pd(_mm512_sub_pd(v_ion, _mm512_sub_pd(m, v_shift)));
+        if (ppm)
+            diff = _mm512_mul_pd(_mm512_div_pd(diff, m), v_ppm);
+        unsigned bits = _mm512_cmp_pd_mask(diff, v_limit, _CMP_LT_OQ)
+            & _mm512_cmp_pd_mask(m, v_shift, _CMP_GT_OQ);
+        while (bits)
+        {
+            marks[i + __builtin_ctz(bits)] = 1;
+            bits &= bits - 1;
+            count++;
+        }
+    }
+    return count + AVX2ToleranceMatch(mass + i, n - i, ion, shift, tol, scale, ppm, marks + i);
+}
+
+__attribute__((target("avx512f")))
+double AVX512MaskedSquareSum(const double* intensity, const char* marks, int n)
+{
+    __m512d v_sum = _mm512_setzero_pd();
+    int i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        long long word;
+        __builtin_memcpy(&word, marks + i, 8);
+        __mmask8 mask = _mm512_test_epi64_mask(
+            _mm512_maskz_cvtepi8_epi64(0xff, _mm_cvtsi64_si128(word)), _mm512_set1_epi64(0xff));
+        __m512d v = _mm512_loadu_pd(intensity + i);
+        v_sum = _mm512_mask_add_pd(v_sum, mask, v_sum, _mm512_mul_pd(v, v));
+    }
+    double lanes[8];
+    _mm512_storeu_pd(lanes, v_sum);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]))
+        + AVX2MaskedSquareSum(intensity + i, marks + i, n - i);
+}
+
+SimdLevel Detect()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+    return SimdLevel::Scalar;
+}
+
+struct Kernels
+{
+    SimdLevel level;
+    ToleranceMatchKernel tolerance_match;
+    MaskedSquareSumKernel masked_square_sum;
+};
+
+Kernels Select(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::AVX512:
+        return Kernels{level, AVX512ToleranceMatch, AVX512MaskedSquareSum};
+    case SimdLevel::AVX2:
+        return Kernels{level, AVX2ToleranceMatch, AVX2MaskedSquareSum};
+    default:
+        break;
+    }
+    return Kernels{SimdLevel::Scalar, ScalarToleranceMatch, ScalarMaskedSquareSum};
+}
+
+// picked at startup
+Kernels kernels = Select(Detect());
+
+} // namespace
+
+SimdLevel Simd::Level() { return kernels.level; }
+
+void Simd::set_level(SimdLevel level)
+{
+    if (Supports(level))
+        kernels = Select(level);
+}
+
+bool Simd::Supports(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::AVX512:
+        return Detect() == SimdLevel::AVX512;
+    case SimdLevel::AVX2:
+        return Detect() != SimdLevel::Scalar;
+    default:
+        break;
+    }
+    return true;
+}
+
+int Simd::ToleranceMatch(const double* mass, int n, double ion, double shift,
+    double tol, double scale, bool ppm, char* marks)
+{
+    return kernels.tolerance_match(mass, n, ion, shift, tol, scale, ppm, marks);
+}
+
+double Simd::MaskedSquareSum(const double* intensity, const char* marks, int n)
+{
+    return kernels.masked_square_sum(intensity, marks, n);
+}
+
+} // namespace calc
+} // namespace util
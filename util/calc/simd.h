@@ -0,0 +1,33 @@
+#ifndef UTIL_CALC_SIMD_H
+#define UTIL_CALC_SIMD_H
+
+namespace util {
+namespace calc {
+
+enum class SimdLevel { Scalar, AVX2, AVX512 };
+
+// vectorized kernels of the spectrum search, for whole arrays of peaks; the
+// few peaks of a bitmap window are cheaper checked inline. The AVX-512, AVX2
+// or scalar version is picked once at startup from the cpu features.
+class Simd
+{
+public:
+    static SimdLevel Level();
+    // force a level, the cpu must support it
+    static void set_level(SimdLevel level);
+    static bool Supports(SimdLevel level);
+
+    // marks[i] = 1 for each mass[i] > shift with (mass[i] - shift) within tolerance
+    // of the ion, |ion - (mass[i] - shift)| < tol * scale, or in ppm of mass[i];
+    // returns the number of masses matched
+    static int ToleranceMatch(const double* mass, int n, double ion, double shift,
+        double tol, double scale, bool ppm, char* marks);
+
+    // sum of intensity[i]^2 where marks[i] != 0
+    static double MaskedSquareSum(const double* intensity, const char* marks, int n);
+};
+
+} // namespace calc
+} // namespace util
+
+#endif
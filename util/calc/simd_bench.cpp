@@ -0,0 +1,134 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "simd.h"
+
+// cost of matching the ions of a candidate against a spectrum, per (ion, charge):
+// the kernels on the few peaks of a bitmap window, an inline scalar loop on
+// the same window, and the kernels on the whole mass array of the charge
+
+using namespace util::calc;
+
+inline int ScalarMatch(const double* mass, int n, double ion, double shift,
+    double tol, double scale, char* marks)
+{
+    int count = 0;
+    for(int i = 0; i < n; i++)
+    {
+        if (mass[i] > shift && std::abs(ion - (mass[i] - shift)) < tol * scale)
+        {
+            marks[i] = 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+int main(int argc, char *argv[])
+{
+    const int peaks = 300, max_charge = 3, ions = 2000, rounds = 2000;
+    const double tol = 0.01;
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> mz(100.0, 2100.0);
+    std::vector<std::vector<double>> mass(max_charge);
+    for(int charge = 1; charge <= max_charge; charge++)
+    {
+        for(int i = 0; i < peaks; i++)
+        {
+            mass[charge - 1].push_back(mz(gen) * charge);
+        }
+        std::sort(mass[charge - 1].begin(), mass[charge - 1].end());
+    }
+    std::vector<double> ion(ions);
+    std::uniform_int_distribution<int> pick(0, peaks - 1);
+    // half the ions fall on a peak of some charge
+    for(int i = 0; i < ions; i++)
+    {
+        int charge = 1 + i % max_charge;
+        ion[i] = i % 2 == 0 ? mass[charge - 1][pick(gen)] + tol / 2 : mz(gen);
+    }
+
+    // the window a bitmap of tol wide bins gathers around each (ion, charge),
+    // only the ones holding a peak get past the bit test
+    std::vector<std::pair<int, int>> range;
+    std::vector<int> range_charge;
+    std::vector<double> range_ion;
+    double width = 0;
+    for(int charge = 1; charge <= max_charge; charge++)
+    {
+        const std::vector<double>& m = mass[charge - 1];
+        for(const auto& it : ion)
+        {
+            int first = std::lower_bound(m.begin(), m.end(), it - 2 * tol * charge) - m.begin();
+            int last = std::upper_bound(m.begin(), m.end(), it + 2 * tol * charge) - m.begin();
+            if (first == last) continue;
+            range.push_back(std::make_pair(first, last));
+            range_charge.push_back(charge);
+            range_ion.push_back(it);
+            width += last - first;
+        }
+    }
+    std::cout << "peaks per window: " << std::fixed << std::setprecision(3)
+        << width / range.size() << std::endl;
+
+    std::vector<char> marks(peaks);
+    std::vector<SimdLevel> levels {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512};
+    const char* names[3] = {"scalar", "avx2", "avx512"};
+    SimdLevel detected = Simd::Level();
+    long found = 0;
+    for(int k = 0; k < 3; k++)
+    {
+        if (!Simd::Supports(levels[k])) continue;
+        Simd::set_level(levels[k]);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for(int r = 0; r < rounds; r++)
+        {
+            for(int j = 0; j < (int) range.size(); j++)
+            {
+                const std::pair<int, int>& w = range[j];
+                found += Simd::ToleranceMatch(mass[range_charge[j] - 1].data() + w.first, w.second - w.first,
+                    range_ion[j], 0, tol, range_charge[j], false, marks.data() + w.first);
+            }
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        double window = std::chrono::duration<double, std::nano>(stop - start).count() / rounds / range.size();
+
+        start = std::chrono::high_resolution_clock::now();
+        for(int r = 0; r < rounds / 10; r++)
+        {
+            for(int j = 0; j < (int) range.size(); j++)
+            {
+                found += Simd::ToleranceMatch(mass[range_charge[j] - 1].data(), peaks,
+                    range_ion[j], 0, tol, range_charge[j], false, marks.data());
+            }
+        }
+        stop = std::chrono::high_resolution_clock::now();
+        double whole = std::chrono::duration<double, std::nano>(stop - start).count() / (rounds / 10) / range.size();
+
+        std::cout << names[k] << " kernel, window: " << window << " ns, whole array: "
+            << whole << " ns" << std::endl;
+    }
+    Simd::set_level(detected);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int r = 0; r < rounds; r++)
+    {
+        for(int j = 0; j < (int) range.size(); j++)
+        {
+            const std::pair<int, int>& w = range[j];
+            found += ScalarMatch(mass[range_charge[j] - 1].data() + w.first, w.second - w.first,
+                range_ion[j], 0, tol, range_charge[j], marks.data() + w.first);
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    double inline_window = std::chrono::duration<double, std::nano>(stop - start).count() / rounds / range.size();
+    std::cout << "inline scalar, window: " << inline_window << " ns" << std::endl;
+    std::cout << "matched: " << found << std::endl;
+    return 0;
+}
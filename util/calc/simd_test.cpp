@@ -0,0 +1,66 @@
+#define BOOST_TEST_MODULE SimdTest
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "simd.h"
+
+namespace util {
+namespace calc {
+
+BOOST_AUTO_TEST_CASE( simd_test )
+{
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> mass(100.0, 2000.0), intensity(0.0, 1000.0);
+    std::vector<double> masses(203), intensities(203);
+    for(auto& it : masses) it = mass(gen);
+    for(auto& it : intensities) it = intensity(gen);
+    std::sort(masses.begin(), masses.end());
+
+    std::vector<SimdLevel> levels {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512};
+    SimdLevel detected = Simd::Level();
+
+    // every supported level agrees with the scalar kernels
+    std::vector<char> expect_marks;
+    double expect_sum = 0;
+    int expect_count = 0;
+    for(const auto& level : levels)
+    {
+        if (!Simd::Supports(level)) continue;
+        Simd::set_level(level);
+        BOOST_CHECK(Simd::Level() == level);
+
+        std::vector<char> marks(masses.size(), 0);
+        int count = 0;
+        for(int k = 0; k < 50; k++)
+        {
+            double ion = masses[k * 4] - 17.0 + (k % 3) * 0.004;
+            count += Simd::ToleranceMatch(masses.data(), masses.size(), ion, 17.0, 0.01, 1 + k % 3, false, marks.data());
+            count += Simd::ToleranceMatch(masses.data(), masses.size(), ion, 17.0, 5, 1, true, marks.data());
+        }
+        double sum = Simd::MaskedSquareSum(intensities.data(), marks.data(), marks.size());
+
+        if (level == SimdLevel::Scalar)
+        {
+            expect_marks = marks;
+            expect_sum = sum;
+            expect_count = count;
+            BOOST_CHECK(count > 50);
+        }
+        BOOST_CHECK(marks == expect_marks);
+        BOOST_CHECK(count == expect_count);
+        BOOST_CHECK(std::abs(sum - expect_sum) <= 1e-9 * expect_sum);
+    }
+    Simd::set_level(detected);
+
+    // masses under the shift never match
+    std::vector<char> marks(3, 0);
+    std::vector<double> low {1.0, 2.0, 3.0};
+    BOOST_CHECK(Simd::ToleranceMatch(low.data(), 3, -1.0, 2.0, 0.5, 1, false, marks.data()) == 0);
+    BOOST_CHECK(Simd::ToleranceMatch(low.data(), 3, 1.0, 2.0, 0.5, 1, false, marks.data()) == 1);
+    BOOST_CHECK(marks[2] == 1);
+}
+
+} // namespace calc
+} // namespace util
@@ -0,0 +1,67 @@
+#ifndef UTIL_IO_BINARY_IO_H_
+#define UTIL_IO_BINARY_IO_H_
+
+#include <vector>
+#include <iostream>
+
+namespace util {
+namespace io {
+
+// raw reads and writes of plain values and vectors of them, for caches
+// written and read back on the same machine
+class BinaryIO
+{
+public:
+    template <typename T>
+    static void Write(std::ostream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static bool Read(std::istream& in, T& value)
+    {
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return (bool) in;
+    }
+
+    template <typename T>
+    static void WriteVector(std::ostream& out, const std::vector<T>& values)
+    {
+        long size = values.size();
+        Write(out, size);
+        if (size > 0)
+            out.write(reinterpret_cast<const char*>(values.data()), sizeof(T) * size);
+    }
+
+    // the size is checked against the bytes left, so a corrupt or truncated
+    // stream fails instead of asking for a huge allocation
+    template <typename T>
+    static bool ReadVector(std::istream& in, std::vector<T>& values)
+    {
+        long size = 0;
+        if (!Read(in, size) || size < 0 || size > Remaining(in) / (long) sizeof(T)) 
+            return false;
+        values.resize(size);
+        if (size > 0)
+            in.read(reinterpret_cast<char*>(values.data()), sizeof(T) * size);
+        return (bool) in;
+    }
+
+    // bytes left in a seekable stream, 0 if it cannot tell
+    static long Remaining(std::istream& in)
+    {
+        std::streampos pos = in.tellg();
+        if (pos < 0) return 0;
+        in.seekg(0, std::ios::end);
+        std::streampos end = in.tellg();
+        in.seekg(pos);
+        if (end < pos) return 0;
+        return (long) (end - pos);
+    }
+};
+
+} // namespace io
+} // namespace util
+
+#endif
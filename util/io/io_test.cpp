@@ -3,7 +3,10 @@
 #include <iostream>
 #include <vector>
 
+#include <sstream>
+
 #include "mgf_parser.h"
+#include "binary_io.h"
 #include "fasta_reader.h"
 
 namespace util {
@@ -25,6 +28,45 @@ BOOST_AUTO_TEST_CASE( mgf_read_test )
     BOOST_CHECK( pk.Intensity() == 238.3); 
 }
 
+BOOST_AUTO_TEST_CASE( mgf_activation_test ) 
+{
+    BOOST_CHECK( MGFParser::Activation("run.1.1.2 HCD", SpectrumType::EThcD) == SpectrumType::HCD); 
+    BOOST_CHECK( MGFParser::Activation("run.1.1.2 cid@35.00", SpectrumType::EThcD) == SpectrumType::HCD); 
+    BOOST_CHECK( MGFParser::Activation("run.1.1.2 [ETD]", SpectrumType::EThcD) == SpectrumType::ETD); 
+    BOOST_CHECK( MGFParser::Activation("ethcd@25 scan=7", SpectrumType::HCD) == SpectrumType::EThcD); 
+    BOOST_CHECK( MGFParser::Activation("synthetic.1.1.3", SpectrumType::EThcD) == SpectrumType::EThcD); 
+    BOOST_CHECK( MGFParser::Activation("method_hcdx", SpectrumType::ETD) == SpectrumType::ETD); 
+    BOOST_CHECK( MGFParser::Activation("FTMS + p NSI d Full ms2 1234.56@etd25.00@hcd20.00 [120.00-2000.00]", 
+        SpectrumType::HCD) == SpectrumType::EThcD); 
+    BOOST_CHECK( MGFParser::Activation("ITMS + c NSI d Full ms2 800.40@etd50.00@cid35.00", 
+        SpectrumType::HCD) == SpectrumType::EThcD); 
+    BOOST_CHECK( MGFParser::Activation("run.1.1.2 ETciD", SpectrumType::HCD) == SpectrumType::EThcD); 
+    BOOST_CHECK( MGFParser::Activation("run.1.1.2 etcad", SpectrumType::HCD) == SpectrumType::EThcD); 
+    BOOST_CHECK( MGFParser::Activation("FTMS + p NSI d Full ms2 800.40@etd50.00", 
+        SpectrumType::HCD) == SpectrumType::ETD); 
+}
+
+BOOST_AUTO_TEST_CASE( binary_io_test ) 
+{
+    std::stringstream stream;
+    std::vector<double> values {1.5, 2.5, 3.5};
+    BinaryIO::WriteVector(stream, values);
+    std::vector<double> read;
+    BOOST_CHECK( BinaryIO::ReadVector(stream, read)); 
+    BOOST_CHECK( read == values); 
+
+    // a size beyond the bytes left fails without allocating it
+    std::stringstream corrupt;
+    BinaryIO::Write(corrupt, 1L << 60);
+    BinaryIO::Write(corrupt, 1.5);
+    BOOST_CHECK( !BinaryIO::ReadVector(corrupt, read)); 
+
+    // and so does a truncated vector
+    std::string bytes = stream.str();
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 4));
+    BOOST_CHECK( !BinaryIO::ReadVector(truncated, read)); 
+}
+
 BOOST_AUTO_TEST_CASE( fasta_read_test ) 
 {
     FASTAReader fasta_reader("/home/yu/Documents/MultiGlycan-Cpp/data/test_fasta.fasta");
@@ -10,6 +10,8 @@
 namespace util {
 namespace io {
 
+// the activation of each scan is read from its TITLE when it names one,
+// otherwise every scan takes the type given here
 class MGFParser : public SpectrumParser
 {   
 public:
@@ -39,6 +41,7 @@ public:
                 if (std::regex_search(line, result, start))
                 {
                     data = MGFData();
+                    data.type = type_;
                     scan_num++;
                 }else if (std::regex_search(line, result, mz_intensity))
                 {
@@ -60,6 +63,7 @@ public:
                 else if (std::regex_search(line, result, title))
                 {
                     data.title = std::string(result[1]);
+                    data.type = Activation(data.title, type_);
                 }
                 else if (std::regex_search(line, result, rt_second))
                 {
@@ -126,7 +130,14 @@ public:
         return peaks;
     }
     SpectrumType GetSpectrumType(int scan_num) override 
-        { return type_; };
+    { 
+        auto it = data_set_.find(scan_num); 
+        if (it != data_set_.end())
+        {
+            return it->second.type;
+        }
+        return type_;
+    }
     double RTFromScanNum(int scan_num) override
     {
         auto it = data_set_.find(scan_num); 
@@ -149,6 +160,28 @@ public:
     {
         return data_set_.find(scan_num) != data_set_.end();
     }
+
+    // activation named in a title, e.g. "... HCD ..." or "ethcd@25", checked
+    // as whole words; an ETD supplemented by collisions, written as EThcD,
+    // ETciD, ETcaD or as both an etd and an hcd/cid step of a Thermo filter
+    // ("@etd25.00@hcd20.00"), is EThcD
+    static SpectrumType Activation(const std::string& title, SpectrumType type)
+    {
+        static const std::regex ethcd("(^|[^a-z])(ethcd|etcid|etcad)([^a-z]|$)", std::regex::icase);
+        static const std::regex etd("(^|[^a-z])etd([^a-z]|$)", std::regex::icase);
+        static const std::regex hcd("(^|[^a-z])(hcd|cid)([^a-z]|$)", std::regex::icase);
+        if (std::regex_search(title, ethcd))
+            return SpectrumType::EThcD;
+        bool electron = std::regex_search(title, etd);
+        bool collision = std::regex_search(title, hcd);
+        if (electron && collision)
+            return SpectrumType::EThcD;
+        if (electron)
+            return SpectrumType::ETD;
+        if (collision)
+            return SpectrumType::HCD;
+        return type;
+    }
     
 private:
     class MGFData
@@ -163,6 +196,7 @@ private:
         double rt_seconds;
         int scans;
         std::string title;
+        SpectrumType type;
     };
     SpectrumType type_;
     std::map<int, MGFData> data_set_;
@@ -1,7 +1,8 @@
 #ifndef UTIL_MASS_ION_H
 #define UTIL_MASS_ION_H
 
-#include<string>
+#include <string>
+#include <vector>
 #include "peptide.h"
 
 namespace util {
@@ -14,36 +15,102 @@ class IonMass
 public:
     static double Compute(const std::string& seq, const IonType ion)
     {
-        double mass = PeptideMass::Compute(seq); //with an addtional h2o
+        //with an addtional h2o
+        return PeptideMass::Compute(seq) + Offset(ion);
+    }
+
+    // mass difference between the ion and the plain fragment with its water
+    static double Offset(const IonType ion)
+    {
         switch (ion)
         {
             case IonType::a:
-                mass = mass - kOxygen * 2 - kHydrogen * 2 - kCarbon;
-                break;
+                return - kOxygen * 2 - kHydrogen * 2 - kCarbon;
             case IonType::b:
-                mass = mass - kOxygen - kHydrogen * 2;
-                break;
+                return - kOxygen - kHydrogen * 2;
             case IonType::c:
-                mass = mass - kOxygen + kHydrogen + kNitrogen;
-                break;
+                return - kOxygen + kHydrogen + kNitrogen;
             case IonType::x:
-                mass += kCarbon + kOxygen - kHydrogen * 2;
-                break;
+                return kCarbon + kOxygen - kHydrogen * 2;
             case IonType::y:
-                break;
+                return 0;
             case IonType::z:
-                mass = mass - kNitrogen - kHydrogen * 3;
-                break;
+                return - kNitrogen - kHydrogen * 3;
         }
-        return mass;
+        return 0;
     }
 
+    static bool NTerminal(const IonType ion)
+        { return ion == IonType::a || ion == IonType::b || ion == IonType::c; }
+
     static constexpr double kCarbon = 12.0;
     static constexpr double kNitrogen = 14.003074;
     static constexpr double kOxygen = 15.99491463;
     static constexpr double kHydrogen = 1.007825;
 };
 
+// fragment ions of one peptide from residue-mass prefix sums,
+// every ion series is generated in O(L) without building substrings
+class IonLadder
+{
+public:
+    IonLadder() = default;
+    IonLadder(const std::string& seq) { Init(seq); }
+
+    void Init(const std::string& seq)
+    {
+        prefix_.resize(seq.length() + 1);
+        prefix_[0] = 0;
+        for (int i = 0; i < (int) seq.length(); i++)
+        {
+            prefix_[i+1] = prefix_[i] + PeptideMass::ResidueMass(seq[i]);
+        }
+    }
+
+    int Length() const { return (int) prefix_.size() - 1; }
+
+    // ion from the cleavage after the first k residues, 1 <= k < Length()
+    double Mass(const int k, const IonType ion) const
+    {
+        if (IonMass::NTerminal(ion))
+            return prefix_[k] + PeptideMass::kWater + IonMass::Offset(ion);
+        return prefix_.back() - prefix_[k] + PeptideMass::kWater + IonMass::Offset(ion);
+    }
+
+    // write ions of cleavages first..last into out, return the end of the written range
+    double* Compute(const IonType ion, const int first, const int last, double* out) const
+    {
+        double offset = PeptideMass::kWater + IonMass::Offset(ion);
+        if (IonMass::NTerminal(ion))
+        {
+            for (int k = first; k <= last; k++)
+                *out++ = prefix_[k] + offset;
+        }
+        else
+        {
+            double total = prefix_.back() + offset;
+            for (int k = first; k <= last; k++)
+                *out++ = total - prefix_[k];
+        }
+        return out;
+    }
+
+    void Compute(const IonType ion, const int first, const int last, std::vector<double>& buffer) const
+    {
+        if (last < first) return;
+        size_t size = buffer.size();
+        buffer.resize(size + last - first + 1);
+        Compute(ion, first, last, buffer.data() + size);
+    }
+
+    // all cleavages of the series
+    void Compute(const IonType ion, std::vector<double>& buffer) const
+        { Compute(ion, 1, Length() - 1, buffer); }
+
+protected:
+    std::vector<double> prefix_;
+};
+
 } // namespace mass
 } // namespace util
 
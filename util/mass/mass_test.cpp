@@ -0,0 +1,45 @@
+#define BOOST_TEST_MODULE MassTest
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+
+#include "ion.h"
+#include "peptide.h"
+
+namespace util {
+namespace mass {
+
+BOOST_AUTO_TEST_CASE( ion_ladder_test )
+{
+    std::string seq = "MVSHHNLTTGATLCINE";
+    IonLadder ladder(seq);
+    BOOST_CHECK(ladder.Length() == (int) seq.length());
+
+    std::vector<IonType> ions
+        { IonType::a, IonType::b, IonType::c, IonType::x, IonType::y, IonType::z };
+    for (const auto& ion : ions)
+    {
+        std::vector<double> buffer;
+        ladder.Compute(ion, buffer);
+        BOOST_CHECK(buffer.size() == seq.length() - 1);
+        for (int k = 1; k < (int) seq.length(); k++)
+        {
+            std::string fragment = IonMass::NTerminal(ion) ?
+                seq.substr(0, k) : seq.substr(k, seq.length() - k);
+            double expect = IonMass::Compute(fragment, ion);
+            BOOST_CHECK(std::abs(buffer[k-1] - expect) < 1e-6);
+            BOOST_CHECK(std::abs(ladder.Mass(k, ion) - expect) < 1e-6);
+        }
+    }
+
+    // partial range appends to the caller's buffer
+    std::vector<double> buffer {0};
+    ladder.Compute(IonType::y, 3, 5, buffer);
+    BOOST_CHECK(buffer.size() == 4);
+    BOOST_CHECK(std::abs(buffer[1] - IonMass::Compute(seq.substr(3), IonType::y)) < 1e-6);
+}
+
+} // namespace mass
+} // namespace util
@@ -12,19 +12,23 @@ class PeptideMass
 public:
     static double Compute(const std::string& seq)
     {
-        double mass = 18.0105;  //water
+        double mass = kWater;
         for (char s : seq)
         {
-            if (std::toupper(s) == 'C')
-            {
-                //Iodoacetamide
-                mass += 57.02146;
-            }
-            mass += GetAminoAcidMW(s);
+            mass += ResidueMass(s);
         }
         return mass;
     }
 
+    // residue mass inside a chain, with the fixed modification on C
+    static double ResidueMass(const char amino)
+    {
+        if (std::toupper(amino) == 'C')
+            return GetAminoAcidMW(amino) + 57.02146; //Iodoacetamide
+        return GetAminoAcidMW(amino);
+    }
+
+    static constexpr double kWater = 18.0105;
 
 protected:
     static double GetAminoAcidMW(const char amino)
@@ -25,6 +25,8 @@ public:
     }
 
     static constexpr double kIon = 1.007825;
+    // spacing of the 13C isotope peaks
+    static constexpr double kIsotope = 1.003355;
 };
 
 } // namespace mass